@@ -0,0 +1,185 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <vsg/io/read.h>
+#include <vsg/nodes/Group.h>
+#include <vsgXchange/all.h>
+#include <iostream>
+#include <set>
+#include "TileLoader.h"
+#include "RouteTypes.h"
+#include "sceneobjects.h"
+
+// headless equivalent of StartDialog::load, reports tile parse costs as json
+
+class CountObjects : public vsg::ConstVisitor
+{
+public:
+    void apply(const vsg::Object &object) override
+    {
+        object.traverse(*this);
+    }
+    void apply(const vsg::Node &node) override
+    {
+        nodes++;
+        if(node.is_compatible(typeid (route::SceneObject)))
+            sceneObjects++;
+        node.traverse(*this);
+    }
+    void apply(const vsg::Data &data) override
+    {
+        if(visited.insert(&data).second)
+            dataBytes += data.dataSize();
+    }
+
+    std::set<const vsg::Data*> visited;
+    qint64 nodes = 0;
+    qint64 sceneObjects = 0;
+    qint64 dataBytes = 0;
+};
+
+struct TileResult
+{
+    QString path;
+    qint64 bytes = 0;
+    qint64 parseNs = 0;
+    qint64 nodes = 0;
+    qint64 sceneObjects = 0;
+    qint64 dataBytes = 0;
+    QString error;
+};
+
+static QJsonObject toJson(const TileResult &result)
+{
+    QJsonObject tile;
+    tile["path"] = result.path;
+    tile["bytes"] = result.bytes;
+    tile["parse_ms"] = static_cast<double>(result.parseNs) / 1e6;
+    tile["nodes"] = result.nodes;
+    tile["scene_objects"] = result.sceneObjects;
+    tile["data_bytes"] = result.dataBytes;
+    if(!result.error.isEmpty())
+        tile["error"] = result.error;
+    return tile;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Headless route load benchmark");
+    parser.addHelpOption();
+    parser.addPositionalArgument("route", "Route directory holding the tiles and the database file");
+    QCommandLineOption threadsOption({"t", "threads"}, "Comma separated loader thread counts", "counts",
+                                     QString::number(QThread::idealThreadCount()));
+    QCommandLineOption extOption({"e", "ext"}, "Tile file extension", "ext", "vsgt");
+    QCommandLineOption cacheOption("no-cache", "Ignore RRS2_CACHE");
+    parser.addOption(threadsOption);
+    parser.addOption(extOption);
+    parser.addOption(cacheOption);
+    parser.process(app);
+
+    if(parser.positionalArguments().size() != 1)
+        parser.showHelp(1);
+
+    QDir routeDir(parser.positionalArguments().front());
+    auto ext = parser.value(extOption);
+
+    registerRouteTypes();
+
+    auto options = vsg::Options::create();
+    if(!parser.isSet(cacheOption))
+        options->fileCache = vsg::getEnv("RRS2_CACHE");
+    options->paths = vsg::getEnvPaths("RRS2_ROOT");
+    options->add(vsgXchange::all::create());
+
+    QStringList tiles;
+    for (const auto &entry : routeDir.entryInfoList({"*." + ext}, QDir::Files, QDir::Name))
+        if(entry.completeBaseName() != "database")
+            tiles << entry.absoluteFilePath();
+
+    QJsonArray runs;
+    for (const auto &count : parser.value(threadsOption).split(',', Qt::SkipEmptyParts))
+    {
+        auto threads = count.toInt();
+        if(threads <= 0)
+            continue;
+        QThreadPool::globalInstance()->setMaxThreadCount(threads);
+
+        auto loader = TileLoader::create(options);
+
+        QElapsedTimer wall;
+        wall.start();
+
+        auto databaseFuture = QtConcurrent::run([options, path=routeDir.filePath("database." + ext)]()
+        {
+            QElapsedTimer timer;
+            timer.start();
+            auto database = vsg::read_cast<vsg::Group>(path.toStdString(), options);
+            return std::make_pair(static_cast<bool>(database), timer.nsecsElapsed());
+        });
+
+        auto load = [loader](const QString &path)
+        {
+            TileResult result;
+            result.path = path;
+            result.bytes = QFileInfo(path).size();
+
+            QElapsedTimer timer;
+            timer.start();
+            try {
+                auto node = loader->read(path);
+                result.parseNs = timer.nsecsElapsed();
+
+                CountObjects counter;
+                node->accept(counter);
+                result.nodes = counter.nodes;
+                result.sceneObjects = counter.sceneObjects;
+                result.dataBytes = counter.dataBytes;
+            }  catch (DatabaseException &ex) {
+                result.parseNs = timer.nsecsElapsed();
+                result.error = ex.getErrPath();
+            }
+            return result;
+        };
+        auto results = QtConcurrent::blockingMapped(tiles, load);
+        auto database = databaseFuture.result();
+
+        auto wallNs = wall.nsecsElapsed();
+
+        QJsonArray tileArray;
+        qint64 bytes = 0;
+        for (const auto &result : results)
+        {
+            bytes += result.bytes;
+            tileArray.append(toJson(result));
+        }
+
+        QJsonObject run;
+        run["threads"] = threads;
+        run["tiles"] = tileArray;
+        run["tile_count"] = tiles.size();
+        run["total_bytes"] = bytes;
+        run["database_ok"] = database.first;
+        run["database_ms"] = static_cast<double>(database.second) / 1e6;
+        run["wall_ms"] = static_cast<double>(wallNs) / 1e6;
+        run["cache_hits"] = loader->cacheHits();
+        run["cache_misses"] = loader->cacheMisses();
+        runs.append(run);
+    }
+
+    QJsonObject report;
+    report["route"] = routeDir.absolutePath();
+    report["runs"] = runs;
+
+    std::cout << QJsonDocument(report).toJson().toStdString();
+
+    return 0;
+}
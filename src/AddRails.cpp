@@ -3,6 +3,7 @@
 #include <vsg/nodes/Switch.h>
 #include <vsg/io/read.h>
 #include "ParentVisitor.h"
+#include "CompileStats.h"
 #include <vsg/viewer/Viewer.h>
 
 
@@ -103,6 +104,7 @@ void AddRails::intersection(const FoundNodes &isection)
         return;
 
     auto result = _database->viewer->compileManager->compile(sleeper);
+    CompileStats::record(sleeper);
     vsg::updateViewer(*_database->viewer, result);
 
     vsg::ref_ptr<route::Trajectory> traj;
@@ -0,0 +1,106 @@
+#include "CompileStats.h"
+#include <vsg/nodes/StateGroup.h>
+#include <vsg/nodes/Geometry.h>
+#include <vsg/nodes/VertexIndexDraw.h>
+#include <vsg/commands/BindVertexBuffers.h>
+#include <vsg/commands/BindIndexBuffer.h>
+#include <vsg/state/BindDescriptorSet.h>
+#include <vsg/state/DescriptorImage.h>
+#include <vsg/state/DescriptorBuffer.h>
+#include <set>
+
+std::atomic<quint64> CompileStats::_calls = 0;
+std::atomic<quint64> CompileStats::_bytes = 0;
+
+class CountBytes : public vsg::Visitor
+{
+public:
+    void apply(vsg::Object &object) override
+    {
+        object.traverse(*this);
+    }
+    void apply(vsg::StateGroup &group) override
+    {
+        for (auto &command : group.stateCommands)
+            command->accept(*this);
+        group.traverse(*this);
+    }
+    void apply(vsg::BindDescriptorSet &bds) override
+    {
+        if(bds.descriptorSet)
+            bds.descriptorSet->accept(*this);
+    }
+    void apply(vsg::BindDescriptorSets &bds) override
+    {
+        for (auto &ds : bds.descriptorSets)
+            if(ds)
+                ds->accept(*this);
+    }
+    void apply(vsg::DescriptorSet &ds) override
+    {
+        for (auto &descriptor : ds.descriptors)
+            if(descriptor)
+                descriptor->accept(*this);
+    }
+    void apply(vsg::DescriptorImage &di) override
+    {
+        for (auto &info : di.imageInfoList)
+            if(info && info->imageView && info->imageView->image)
+                add(info->imageView->image->data);
+    }
+    void apply(vsg::DescriptorBuffer &db) override
+    {
+        for (auto &info : db.bufferInfoList)
+            if(info)
+                add(info->data);
+    }
+    void apply(vsg::VertexIndexDraw &vid) override
+    {
+        for (auto &info : vid.arrays)
+            if(info)
+                add(info->data);
+        if(vid.indices)
+            add(vid.indices->data);
+    }
+    void apply(vsg::Geometry &geometry) override
+    {
+        for (auto &info : geometry.arrays)
+            if(info)
+                add(info->data);
+        if(geometry.indices)
+            add(geometry.indices->data);
+    }
+    void apply(vsg::BindVertexBuffers &bvb) override
+    {
+        for (auto &info : bvb.arrays)
+            if(info)
+                add(info->data);
+    }
+    void apply(vsg::BindIndexBuffer &bib) override
+    {
+        if(bib.indices)
+            add(bib.indices->data);
+    }
+
+    quint64 bytes = 0;
+
+private:
+    void add(const vsg::ref_ptr<vsg::Data> &data)
+    {
+        // shared data is uploaded once
+        if(data && seen.insert(data.get()).second)
+            bytes += data->dataSize();
+    }
+
+    std::set<const vsg::Data*> seen;
+};
+
+void CompileStats::record(vsg::Object *object)
+{
+    if(!object)
+        return;
+    CountBytes count;
+    object->accept(count);
+    _calls++;
+    _bytes += count.bytes;
+}
@@ -0,0 +1,24 @@
+#ifndef COMPILESTATS_H
+#define COMPILESTATS_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <vsg/core/Object.h>
+
+// counts what is handed to the gpu, moving nodes around the tree should leave it as it is
+class CompileStats
+{
+public:
+    // called next to every compile, from any thread
+    static void record(vsg::Object *object);
+
+    static quint64 calls() noexcept { return _calls; }
+    // vertex, index, image and uniform data reachable from the compiled nodes
+    static quint64 bytes() noexcept { return _bytes; }
+
+private:
+    static std::atomic<quint64> _calls;
+    static std::atomic<quint64> _bytes;
+};
+
+#endif // COMPILESTATS_H
@@ -0,0 +1,97 @@
+#include "CompressedTile.h"
+#include <QDataStream>
+#include <QFileInfo>
+#include <QtConcurrent>
+#include <cstring>
+#include <vector>
+
+namespace {
+    constexpr quint32 MAGIC = 0x5653475a; // "VSGZ"
+    constexpr quint32 VERSION = 1;
+    // blocks are packed with the zlib that comes with Qt, the field leaves room for other codecs
+    constexpr quint32 CODEC_ZLIB = 1;
+    constexpr int LEVEL = 6;
+    // magic, version, codec, block size, raw size and block count
+    constexpr qint64 HEADER_SIZE = 4 * 4 + 8 + 4;
+
+    struct Block
+    {
+        qint64 offset = 0;
+        quint32 size = 0;
+        quint64 target = 0;
+    };
+}
+
+bool CompressedTile::isCompressed(const QString &path)
+{
+    return path.endsWith(EXTENSION, Qt::CaseInsensitive);
+}
+
+QString CompressedTile::compressedPath(const QString &path)
+{
+    QFileInfo fi(path);
+    return fi.path() + "/" + fi.completeBaseName() + EXTENSION;
+}
+
+QByteArray CompressedTile::compress(const char *data, std::size_t size)
+{
+    std::vector<quint64> offsets;
+    for (quint64 offset = 0; offset < size; offset += BLOCK_SIZE)
+        offsets.push_back(offset);
+
+    auto blocks = QtConcurrent::blockingMapped<QList<QByteArray>>(offsets, [data, size](quint64 offset)
+    {
+        auto length = std::min<quint64>(BLOCK_SIZE, size - offset);
+        return qCompress(reinterpret_cast<const uchar*>(data + offset), static_cast<int>(length), LEVEL);
+    });
+
+    QByteArray container;
+    QDataStream out(&container, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << MAGIC << VERSION << CODEC_ZLIB << BLOCK_SIZE << static_cast<quint64>(size) << static_cast<quint32>(blocks.size());
+    for (const auto &block : blocks)
+        out << static_cast<quint32>(block.size());
+    for (const auto &block : blocks)
+        out.writeRawData(block.constData(), static_cast<int>(block.size()));
+    return container;
+}
+
+bool CompressedTile::decompress(const char *data, std::size_t size, std::string &out)
+{
+    auto container = QByteArray::fromRawData(data, static_cast<qsizetype>(size));
+    QDataStream in(container);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0, version = 0, codec = 0, blockSize = 0, count = 0;
+    quint64 rawSize = 0;
+    in >> magic >> version >> codec >> blockSize >> rawSize >> count;
+    if(in.status() != QDataStream::Ok || magic != MAGIC || version != VERSION || codec != CODEC_ZLIB || blockSize == 0)
+        return false;
+    // a damaged header must not make us allocate whatever it says
+    if(count != (rawSize + blockSize - 1) / blockSize || HEADER_SIZE + 4 * static_cast<qint64>(count) > static_cast<qint64>(size))
+        return false;
+
+    std::vector<Block> blocks(count);
+    auto offset = HEADER_SIZE + 4 * static_cast<qint64>(count);
+    for (quint32 i = 0; i < count; ++i)
+    {
+        in >> blocks[i].size;
+        blocks[i].offset = offset;
+        blocks[i].target = static_cast<quint64>(i) * blockSize;
+        offset += blocks[i].size;
+    }
+    if(in.status() != QDataStream::Ok || offset > static_cast<qint64>(size))
+        return false;
+
+    // every block lands in its own part of the output, so they are unpacked in place
+    out.resize(rawSize);
+    auto unpacked = QtConcurrent::blockingMapped<QList<bool>>(blocks, [data, &out, blockSize, rawSize](const Block &block)
+    {
+        auto bytes = qUncompress(reinterpret_cast<const uchar*>(data + block.offset), static_cast<int>(block.size));
+        if(static_cast<quint64>(bytes.size()) != std::min<quint64>(blockSize, rawSize - block.target))
+            return false;
+        std::memcpy(out.data() + block.target, bytes.constData(), static_cast<std::size_t>(bytes.size()));
+        return true;
+    });
+    return !unpacked.contains(false);
+}
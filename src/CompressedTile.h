@@ -0,0 +1,24 @@
+#ifndef COMPRESSEDTILE_H
+#define COMPRESSEDTILE_H
+
+#include <QByteArray>
+#include <QString>
+#include <string>
+
+// .vsgz tiles hold VSG binary cut into blocks that are compressed on their own,
+// so a single large tile is packed and unpacked on all cores
+class CompressedTile
+{
+public:
+    static bool isCompressed(const QString &path);
+    static QString compressedPath(const QString &path);
+
+    static QByteArray compress(const char *data, std::size_t size);
+    // false if the container is damaged or written by a newer version
+    static bool decompress(const char *data, std::size_t size, std::string &out);
+
+    static constexpr const char* EXTENSION = ".vsgz";
+    static constexpr quint32 BLOCK_SIZE = 1 << 20;
+};
+
+#endif // COMPRESSEDTILE_H
@@ -5,6 +5,7 @@
 #include <vsg/io/read.h>
 #include "ParentVisitor.h"
 #include "DatabaseManager.h"
+#include "CompileStats.h"
 #include <vsg/viewer/Viewer.h>
 #include "signals.h"
 
@@ -36,7 +37,16 @@ void ContentManager::intersection(const FoundNodes &isection)
     }
     auto path = _fsmodel->filePath(activeFile).toStdString();
 
-    auto load = [database=_database, activeGroup=_activeGroup, loadToSelected=!ui->autoGroup->isChecked(), useLinks=ui->useLinks->isChecked(), path, isection]()
+    // the model is only read here, the loader runs on a worker
+    std::vector<const vsg::Node*> groupPath;
+    if(loadToSelected)
+    {
+        auto group = static_cast<vsg::Node*>(_activeGroup.internalPointer());
+        groupPath = _database->tilesModel->nodePath(group);
+        groupPath.push_back(group);
+    }
+
+    auto load = [database=_database, loadToSelected=!ui->autoGroup->isChecked(), useLinks=ui->useLinks->isChecked(), path, isection, groupPath]()
     {
         std::pair<vsg::ref_ptr<route::SceneObject>, vsg::CompileResult> loaded;
         auto node = vsg::read_cast<vsg::Node>(path, database->builder->options);
@@ -44,6 +54,7 @@ void ContentManager::intersection(const FoundNodes &isection)
             return loaded;
 
         loaded.second = database->viewer->compileManager->compile(node);
+        CompileStats::record(node);
 
         if(auto object = node->cast<route::SceneObject>(); object)
         {
@@ -57,14 +68,7 @@ void ContentManager::intersection(const FoundNodes &isection)
         auto norm = vsg::normalize(world);
 
         if(loadToSelected)
-        {
-            auto group = static_cast<vsg::Node*>(activeGroup.internalPointer());
-
-            ParentTracer pt;
-            group->accept(pt);
-            pt.nodePath.push_back(group);
-            ltw = vsg::computeTransform(pt.nodePath);
-        }
+            ltw = vsg::computeTransform(groupPath);
         else
             wquat = vsg::dquat(vsg::dvec3(0.0, 0.0, 1.0), norm);
 
@@ -105,10 +109,9 @@ void ContentManager::intersection(const FoundNodes &isection)
             activeGroup = _activeGroup;
             auto group = static_cast<vsg::Node*>(_activeGroup.internalPointer());
 
-            ParentTracer pt;
-            group->accept(pt);
-            pt.nodePath.push_back(group);
-            obj.first->localToWorld = vsg::inverse(vsg::computeTransform(pt.nodePath));
+            auto groupPath = _database->tilesModel->nodePath(group);
+            groupPath.push_back(group);
+            obj.first->localToWorld = vsg::inverse(vsg::computeTransform(groupPath));
             obj.first->recalculateWireframe();
         }
         else if(isection.tile)
@@ -154,7 +157,6 @@ bool ContentManager::addToTrack(vsg::ref_ptr<route::SceneObject> obj, const Foun
     auto coord = traj->invert(isection.intersection->worldIntersection);
     //obj->recalculateWireframe();
     auto transform = vsg::MatrixTransform::create();
-    obj->setValue(app::PARENT, transform.get());
     transform->addChild(obj);
     transform->setValue(app::PROP, coord);
     obj->world_quat = {0.0, 0.0, 0.0, 1.0};
@@ -0,0 +1,242 @@
+#include "DataSharing.h"
+#include "sceneobjects.h"
+#include <QCryptographicHash>
+#include <QHash>
+#include <vsg/io/VSG.h>
+#include <vsg/nodes/Switch.h>
+#include <vsg/nodes/StateGroup.h>
+#include <vsg/nodes/Geometry.h>
+#include <vsg/nodes/VertexIndexDraw.h>
+#include <vsg/commands/BindVertexBuffers.h>
+#include <vsg/commands/BindIndexBuffer.h>
+#include <vsg/state/BindDescriptorSet.h>
+#include <vsg/state/DescriptorImage.h>
+#include <vsg/state/DescriptorBuffer.h>
+#include <cstring>
+#include <map>
+#include <ostream>
+#include <set>
+#include <streambuf>
+#include <unordered_map>
+
+// feeds whatever is written straight into the hash, nothing of the serialized form is kept
+class HashBuffer : public std::streambuf
+{
+public:
+    HashBuffer() : hash(QCryptographicHash::Sha1) {}
+
+    QCryptographicHash hash;
+
+protected:
+    std::streamsize xsputn(const char *s, std::streamsize n) override
+    {
+        hash.addData(QByteArrayView(s, static_cast<qsizetype>(n)));
+        return n;
+    }
+    int_type overflow(int_type ch) override
+    {
+        if(!traits_type::eq_int_type(ch, traits_type::eof()))
+        {
+            auto c = traits_type::to_char_type(ch);
+            hash.addData(QByteArrayView(&c, 1));
+        }
+        return traits_type::not_eof(ch);
+    }
+};
+
+class CollectSlots : public vsg::Visitor
+{
+public:
+    CollectSlots(vsg::ref_ptr<const vsg::Options> in_options) : options(in_options) {}
+
+    void apply(vsg::Object &object) override
+    {
+        object.traverse(*this);
+    }
+    void apply(vsg::Switch &sw) override
+    {
+        for (auto &child : sw.children)
+            if((child.mask & route::Tiles) == 0)
+                child.node->accept(*this);
+    }
+    void apply(vsg::StateGroup &group) override
+    {
+        for (auto &command : group.stateCommands)
+        {
+            if(command->is_compatible(typeid (vsg::BindDescriptorSet)) || command->is_compatible(typeid (vsg::BindDescriptorSets)))
+                addState(command);
+            command->accept(*this);
+        }
+        group.traverse(*this);
+    }
+    void apply(vsg::BindDescriptorSet &bds) override
+    {
+        if(bds.descriptorSet)
+            bds.descriptorSet->accept(*this);
+    }
+    void apply(vsg::BindDescriptorSets &bds) override
+    {
+        for (auto &ds : bds.descriptorSets)
+            if(ds)
+                ds->accept(*this);
+    }
+    void apply(vsg::DescriptorSet &ds) override
+    {
+        for (auto &descriptor : ds.descriptors)
+            if(descriptor)
+                descriptor->accept(*this);
+    }
+    void apply(vsg::DescriptorImage &di) override
+    {
+        for (auto &info : di.imageInfoList)
+            if(info && info->imageView && info->imageView->image)
+                addData(info->imageView->image->data);
+    }
+    void apply(vsg::DescriptorBuffer &db) override
+    {
+        for (auto &info : db.bufferInfoList)
+            if(info)
+                addData(info->data);
+    }
+    void apply(vsg::VertexIndexDraw &vid) override
+    {
+        for (auto &info : vid.arrays)
+            if(info)
+                addData(info->data);
+        if(vid.indices)
+            addData(vid.indices->data);
+    }
+    void apply(vsg::Geometry &geometry) override
+    {
+        for (auto &info : geometry.arrays)
+            if(info)
+                addData(info->data);
+        if(geometry.indices)
+            addData(geometry.indices->data);
+    }
+    void apply(vsg::BindVertexBuffers &bvb) override
+    {
+        for (auto &info : bvb.arrays)
+            if(info)
+                addData(info->data);
+    }
+    void apply(vsg::BindIndexBuffer &bib) override
+    {
+        if(bib.indices)
+            addData(bib.indices->data);
+    }
+
+    DataSharing::TileDigest digest;
+    vsg::ref_ptr<const vsg::Options> options;
+
+private:
+    void addData(vsg::ref_ptr<vsg::Data> &data)
+    {
+        // data carrying aux values (geo transforms and the like) is left alone
+        if(!data || data->getAuxiliary() || !slots.insert(&data).second)
+            return;
+        auto hash = qHashBits(data->dataPointer(), data->dataSize(), qHash(QByteArray(data->className())));
+        digest.data.push_back({&data, hash});
+    }
+    void addState(vsg::ref_ptr<vsg::StateCommand> &command)
+    {
+        if(!slots.insert(&command).second)
+            return;
+        HashBuffer buffer;
+        std::ostream stream(&buffer);
+        vsg::VSG io;
+        io.write(command, stream, options);
+        digest.state.push_back({&command, buffer.hash.result()});
+    }
+
+    std::set<const void*> slots;
+};
+
+DataSharing::TileDigest DataSharing::digest(vsg::Node *tile, vsg::ref_ptr<const vsg::Options> options)
+{
+    auto binary = vsg::Options::create(*options);
+    binary->extensionHint = ".vsgb";
+
+    CollectSlots collect(binary);
+    tile->accept(collect);
+    return collect.digest;
+}
+
+static bool sameData(const vsg::Data *lhs, const vsg::Data *rhs)
+{
+    return std::strcmp(lhs->className(), rhs->className()) == 0
+            && lhs->dataSize() == rhs->dataSize()
+            && lhs->width() == rhs->width() && lhs->height() == rhs->height() && lhs->depth() == rhs->depth()
+            && std::memcmp(lhs->dataPointer(), rhs->dataPointer(), lhs->dataSize()) == 0;
+}
+
+void DataSharing::share(std::vector<TileDigest> &tiles)
+{
+    std::unordered_map<std::size_t, std::vector<vsg::ref_ptr<vsg::Data>>> dataPool;
+    std::map<QByteArray, vsg::ref_ptr<vsg::StateCommand>> statePool;
+
+    for (auto &tile : tiles)
+    {
+        // a tile never ends up referencing one instance where it had two, so it is written back unchanged
+        std::map<const vsg::Object*, vsg::ref_ptr<vsg::Object>> replaced;
+        std::map<const vsg::Object*, const vsg::Object*> owners;
+        std::vector<vsg::ref_ptr<vsg::Object>> originals;
+
+        auto canonical = [&](vsg::ref_ptr<vsg::Object> original, vsg::ref_ptr<vsg::Object> candidate)
+        {
+            if(auto it = owners.find(candidate); it != owners.end() && it->second != original.get())
+                candidate = original;
+            owners[candidate] = original;
+            replaced[original] = candidate;
+            originals.push_back(original);
+            return candidate;
+        };
+
+        for (auto &slot : tile.data)
+        {
+            auto original = *slot.data;
+            if(auto it = replaced.find(original); it != replaced.end())
+            {
+                *slot.data = it->second.cast<vsg::Data>();
+                continue;
+            }
+
+            auto &candidates = dataPool[slot.hash];
+            auto found = std::find_if(candidates.begin(), candidates.end(), [&original](const auto &candidate)
+            {
+                return sameData(candidate, original);
+            });
+            if(found == candidates.end())
+            {
+                candidates.push_back(original);
+                canonical(original, original);
+                continue;
+            }
+
+            auto shared = canonical(original, *found).cast<vsg::Data>();
+            if(shared != original)
+            {
+                _savedBytes += original->dataSize();
+                *slot.data = shared;
+            }
+        }
+
+        for (auto &slot : tile.state)
+        {
+            auto original = *slot.command;
+            if(auto it = replaced.find(original); it != replaced.end())
+            {
+                *slot.command = it->second.cast<vsg::StateCommand>();
+                continue;
+            }
+
+            auto found = statePool.try_emplace(slot.hash, original).first;
+            auto shared = canonical(original, found->second).cast<vsg::StateCommand>();
+            if(shared != original)
+            {
+                _sharedStates++;
+                *slot.command = shared;
+            }
+        }
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef DATASHARING_H
+#define DATASHARING_H
+
+#include <QByteArray>
+#include <vsg/core/Data.h>
+#include <vsg/nodes/Node.h>
+#include <vsg/state/StateCommand.h>
+#include <vsg/io/Options.h>
+
+// shares identical vertex, index, image data and descriptor sets between tiles
+class DataSharing
+{
+public:
+    struct DataSlot
+    {
+        vsg::ref_ptr<vsg::Data> *data;
+        std::size_t hash;
+    };
+
+    struct StateSlot
+    {
+        vsg::ref_ptr<vsg::StateCommand> *command;
+        QByteArray hash;
+    };
+
+    struct TileDigest
+    {
+        std::vector<DataSlot> data;
+        std::vector<StateSlot> state;
+    };
+
+    // hashes the payloads of one tile, terrain is left out since it is painted in place
+    static TileDigest digest(vsg::Node *tile, vsg::ref_ptr<const vsg::Options> options);
+
+    // must run on one thread after every tile is digested, the tiles must not change in between
+    void share(std::vector<TileDigest> &tiles);
+
+    std::size_t savedBytes() const noexcept { return _savedBytes; }
+    int sharedStates() const noexcept { return _sharedStates; }
+
+private:
+    std::size_t _savedBytes = 0;
+    int _sharedStates = 0;
+};
+
+#endif // DATASHARING_H
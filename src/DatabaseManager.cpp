@@ -3,10 +3,20 @@
 #include "vsgGIS/TileDatabase.h"
 #include <QtConcurrent/QtConcurrent>
 #include <QInputDialog>
+#include <QApplication>
 #include "undo-redo.h"
 #include "topology.h"
 #include "ParentVisitor.h"
+#include "TextureCompressor.h"
+#include "MemoryStream.h"
+#include "CompressedTile.h"
+#include "CompileStats.h"
+#include <sstream>
 #include <QRegularExpression>
+#include <QSaveFile>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
 
 DatabaseManager::DatabaseManager(vsg::ref_ptr<vsg::Group> database, vsg::ref_ptr<vsg::Group> nodes, vsg::ref_ptr<vsg::Options> options)
   : root(nodes)
@@ -15,6 +25,8 @@ DatabaseManager::DatabaseManager(vsg::ref_ptr<vsg::Group> database, vsg::ref_ptr
     builder = vsg::Builder::create();
     builder->options = options;
 
+    loader = TileLoader::create(options);
+
     topology = _database->getObject<route::Topology>(app::TOPOLOGY);
     if(!topology)
     {
@@ -26,8 +38,6 @@ DatabaseManager::DatabaseManager(vsg::ref_ptr<vsg::Group> database, vsg::ref_ptr
     modelroot->addChild(nodes);
     modelroot->addChild(database);
 
-    vsg::visit<ParentIndexer>(modelroot);
-
     tilesModel = new SceneModel(modelroot, builder, undoStack);
 }
 DatabaseManager::~DatabaseManager()
@@ -75,6 +85,314 @@ void DatabaseManager::setViewer(vsg::ref_ptr<vsg::Viewer> viewer)
 
 vsg::ref_ptr<vsg::Group> DatabaseManager::getDatabase() const noexcept { return _database; }
 
+void DatabaseManager::setPendingTiles(const QStringList &tiles)
+{
+    _pendingTiles = tiles;
+}
+
+QFuture<void> DatabaseManager::loadTiles(QProgressBar *bar)
+{
+    Q_ASSERT(viewer);
+
+    using Loaded = std::pair<vsg::ref_ptr<vsg::Node>, vsg::CompileResult>;
+
+    auto load = [loader=loader, viewer=viewer](const QString &path)
+    {
+        Loaded loaded;
+        try {
+            loaded.first = loader->read(path);
+        }  catch (DatabaseException &) {
+            return loaded;
+        }
+        loaded.second = viewer->compileManager->compile(loaded.first);
+        CompileStats::record(loaded.first);
+        return loaded;
+    };
+
+    auto pending = _pendingTiles.size();
+    auto future = QtConcurrent::mapped(_pendingTiles, load);
+    _pendingTiles.clear();
+
+    tilesModel->setLoading(root.get(), pending);
+
+    // tiles are attached on the gui thread as soon as each batch of results is ready
+    auto watcher = new QFutureWatcher<Loaded>();
+    QObject::connect(watcher, &QFutureWatcher<Loaded>::resultsReadyAt, watcher, [this, watcher, pending](int begin, int end)
+    {
+        auto rootIndex = tilesModel->index(root);
+        for (int i = begin; i < end; ++i)
+        {
+            auto loaded = watcher->resultAt(i);
+            if(!loaded.first)
+                continue;
+            vsg::updateViewer(*viewer, loaded.second);
+            tilesModel->addNode(rootIndex, loaded.first);
+        }
+        tilesModel->setLoading(root.get(), pending - watcher->progressValue());
+    });
+    QObject::connect(watcher, &QFutureWatcher<Loaded>::finished, watcher, [this, watcher]()
+    {
+        tilesModel->setLoading(root.get(), 0);
+        watcher->deleteLater();
+    });
+    if(bar)
+    {
+        QObject::connect(watcher, &QFutureWatcher<Loaded>::progressRangeChanged, bar, &QProgressBar::setRange);
+        QObject::connect(watcher, &QFutureWatcher<Loaded>::progressValueChanged, bar, &QProgressBar::setValue);
+        QObject::connect(watcher, &QFutureWatcher<Loaded>::finished, bar, &QProgressBar::hide);
+    }
+    watcher->setFuture(future);
+
+    return QFuture<void>(future);
+}
+
+void DatabaseManager::requestTile(const QModelIndex &index)
+{
+    if(!index.isValid())
+        return;
+    auto node = static_cast<vsg::Node*>(index.internalPointer());
+    touchTile(node);
+    if(auto stub = node->cast<vsg::Switch>(); stub)
+        requestTile(stub);
+}
+
+void DatabaseManager::requestTile(vsg::Switch *stub)
+{
+    Q_ASSERT(viewer);
+
+    if(!TileLoader::isStub(stub) || _requestedTiles.contains(stub))
+        return;
+    _requestedTiles.insert(stub);
+
+    std::string path;
+    stub->getValue(app::PATH, path);
+
+    tilesModel->setLoading(stub, 1);
+
+    using Loaded = std::pair<vsg::ref_ptr<vsg::Node>, vsg::CompileResult>;
+    QtConcurrent::run([loader=loader, viewer=viewer, path=QString::fromStdString(path)]()
+    {
+        Loaded loaded;
+        try {
+            loaded.first = loader->read(path);
+        }  catch (DatabaseException &) {
+            return loaded;
+        }
+        loaded.second = viewer->compileManager->compile(loaded.first);
+        CompileStats::record(loaded.first);
+        return loaded;
+    }).then(qApp, [this, stub=vsg::ref_ptr<vsg::Switch>(stub)](Loaded loaded)
+    {
+        _requestedTiles.remove(stub.get());
+        tilesModel->setLoading(stub, 0);
+        // the tile may have been loaded synchronously in the meantime
+        if(!loaded.first || !TileLoader::isStub(stub))
+            return;
+        vsg::updateViewer(*viewer, loaded.second);
+        attachTile(stub, loaded.first);
+    });
+}
+
+void DatabaseManager::loadTile(vsg::Switch *stub)
+{
+    Q_ASSERT(viewer);
+
+    if(!TileLoader::isStub(stub))
+        return;
+
+    std::string path;
+    stub->getValue(app::PATH, path);
+
+    vsg::ref_ptr<vsg::Node> tile;
+    try {
+        tile = loader->read(QString::fromStdString(path));
+    }  catch (DatabaseException &) {
+        return;
+    }
+    auto result = viewer->compileManager->compile(tile);
+    CompileStats::record(tile);
+    vsg::updateViewer(*viewer, result);
+    attachTile(stub, tile);
+}
+
+void DatabaseManager::attachTile(vsg::Switch *stub, vsg::ref_ptr<vsg::Node> tile)
+{
+    auto loaded = tile.cast<vsg::Switch>();
+    if(!loaded)
+        return;
+
+    ResidentTile resident;
+    resident.bounds = TileLoader::stubBounds(stub);
+    resident.bytes = TileLoader::dataSize(loaded);
+    resident.used = ++_tick;
+    _residentTiles.insert(stub, resident);
+
+    // keep the stub node itself so model indexes and undo commands stay valid
+    if(auto aux = tile->getAuxiliary(); aux)
+    {
+        for (const auto &[key, object] : aux->userObjects)
+            stub->setObject(key, object);
+    }
+    stub->removeObject(TileLoader::STUB);
+    stub->removeObject(TileLoader::BOUND_MIN);
+    stub->removeObject(TileLoader::BOUND_MAX);
+    stub->removeObject(TileLoader::OBJECTS);
+
+    tilesModel->setChildren(stub, loaded->children);
+}
+
+static double distance(const vsg::dbox &bounds, const vsg::dvec3 &point)
+{
+    auto nearest = vsg::dvec3(std::clamp(point.x, bounds.min.x, bounds.max.x),
+                              std::clamp(point.y, bounds.min.y, bounds.max.y),
+                              std::clamp(point.z, bounds.min.z, bounds.max.z));
+    return vsg::length(nearest - point);
+}
+
+void DatabaseManager::requestTilesNear(const vsg::dvec3 &eye)
+{
+    if(lazyDistance <= 0.0)
+        return;
+
+    _eye = eye;
+
+    for (auto &child : root->children)
+    {
+        auto stub = child->cast<vsg::Switch>();
+        if(!stub)
+            continue;
+        if(auto resident = _residentTiles.find(stub); resident != _residentTiles.end())
+        {
+            if(distance(resident->bounds, eye) < lazyDistance)
+                resident->used = ++_tick;
+        }
+        else if(TileLoader::isStub(stub) && distance(TileLoader::stubBounds(stub), eye) < lazyDistance)
+            requestTile(stub);
+    }
+}
+
+void DatabaseManager::loadIntersectedTiles(vsg::Intersector &intersector)
+{
+    auto intersects = [&intersector](const vsg::dbox &bounds)
+    {
+        return intersector.intersects(vsg::dsphere((bounds.min + bounds.max) * 0.5, vsg::length(bounds.max - bounds.min) * 0.5));
+    };
+
+    for (auto &child : root->children)
+    {
+        auto stub = child->cast<vsg::Switch>();
+        if(!stub)
+            continue;
+        if(auto resident = _residentTiles.find(stub); resident != _residentTiles.end())
+        {
+            if(intersects(resident->bounds))
+                resident->used = ++_tick;
+        }
+        // read and compiled in the background like tiles near the camera, a later ray finds it loaded
+        else if(TileLoader::isStub(stub) && intersects(TileLoader::stubBounds(stub)))
+            requestTile(stub);
+    }
+}
+
+vsg::dbox DatabaseManager::stubBounds() const
+{
+    vsg::dbox bounds;
+    for (const auto &child : root->children)
+    {
+        if(TileLoader::isStub(child))
+            bounds.add(TileLoader::stubBounds(child));
+    }
+    return bounds;
+}
+
+std::size_t DatabaseManager::residentBytes() const
+{
+    std::size_t bytes = 0;
+    for (const auto &resident : _residentTiles)
+        bytes += resident.bytes;
+    return bytes;
+}
+
+void DatabaseManager::evictTiles()
+{
+    // children evicted on the previous pass are released only now, after the frames using them were presented
+    _retiredTiles.clear();
+
+    // tiles being snapshotted are read on the workers
+    auto resident = residentBytes();
+    if(tilesBudget == 0 || resident <= tilesBudget || isSnapshotting())
+        return;
+
+    auto pinned = pinnedTiles();
+
+    std::vector<std::pair<quint64, vsg::Switch*>> candidates;
+    for (auto &child : root->children)
+    {
+        auto tile = child->cast<vsg::Switch>();
+        if(!tile || pinned.contains(tile) || _requestedTiles.contains(tile))
+            continue;
+        if(auto it = _residentTiles.find(tile); it != _residentTiles.end() && distance(it->bounds, _eye) >= lazyDistance)
+            candidates.emplace_back(it->used, tile);
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    for (const auto &[used, tile] : candidates)
+    {
+        if(resident <= tilesBudget)
+            break;
+        resident -= _residentTiles.take(tile).bytes;
+        TileLoader::markStub(tile, tile);
+
+        // the index keeps the evicted objects visible in the tree
+        std::string path;
+        tile->getValue(app::PATH, path);
+        auto placeholders = routeIndex ? routeIndex->placeholders(QString::fromStdString(path)) : vsg::Switch::Children();
+        _retiredTiles.push_back(tilesModel->setChildren(tile, placeholders));
+    }
+}
+
+void DatabaseManager::touchTile(const vsg::Node *tile)
+{
+    if(auto resident = _residentTiles.find(tile); resident != _residentTiles.end())
+        resident->used = ++_tick;
+}
+
+const vsg::Node *DatabaseManager::tileOf(const vsg::Node *node) const
+{
+    while(node)
+    {
+        auto parent = tilesModel->parentNode(node);
+        // trajectories hang from the root too, they are stored with the database and own no file
+        if(parent == root.get())
+        {
+            std::string path;
+            return node->is_compatible(typeid (vsg::Switch)) && node->getValue(app::PATH, path) ? node : nullptr;
+        }
+        node = parent;
+    }
+    return nullptr;
+}
+
+QSet<const vsg::Node*> DatabaseManager::pinnedTiles() const
+{
+    // a tile stays resident while any command on the stack may still touch it or it is unsaved
+    auto pinned = _dirtyTiles;
+    std::function<void(const QUndoCommand*)> pin = [this, &pinned, &pin](const QUndoCommand *command)
+    {
+        if(auto scene = dynamic_cast<const SceneCommand*>(command); scene)
+        {
+            for (auto target : scene->targets())
+                if(auto tile = tileOf(target); tile)
+                    pinned.insert(tile);
+        }
+        for (int i = 0; i < command->childCount(); ++i)
+            pin(command->child(i));
+    };
+    for (int i = 0; i < undoStack->count(); ++i)
+        pin(undoStack->command(i));
+    return pinned;
+}
+
 vsg::ref_ptr<vsg::Node> DatabaseManager::getStdWireBox()
 {
     if(!_compiled)
@@ -91,47 +409,306 @@ vsg::ref_ptr<vsg::Node> DatabaseManager::getStdAxis()
     return _stdAxis;
 }
 
-void DatabaseManager::writeTiles()
+void DatabaseManager::markDirty(const vsg::Node *node, bool topology)
 {
-    auto removeBounds = [](vsg::VertexIndexDraw& object)
+    if(auto tile = tileOf(node); tile)
+        _dirtyTiles.insert(tile);
+    else
+        _dirtyDatabase = true;
+    _dirtyDatabase |= topology;
+}
+
+DatabaseManager::Changes DatabaseManager::unsavedChanges() const
+{
+    Changes changes;
+    changes.tiles = _dirtyTiles;
+    changes.database = _dirtyDatabase;
+
+    // the saved state is gone from the stack, nothing tells what differs from disk
+    auto clean = undoStack->cleanIndex();
+    if(clean < 0)
     {
-        object.removeObject("bound");
-    };
-    LambdaVisitor<decltype (removeBounds), vsg::VertexIndexDraw> lv(removeBounds);
+        changes.all = true;
+        return changes;
+    }
 
-    auto removeParents = [](vsg::Node& node)
+    // commands between the saved and the current state, in either direction, are unsaved
+    std::function<void(const QUndoCommand*)> collect = [this, &changes, &collect](const QUndoCommand *command)
     {
-        node.removeObject(app::PARENT);
+        if(auto scene = dynamic_cast<const SceneCommand*>(command); scene)
+        {
+            // nodes outside of tiles are stored with the database
+            for (auto target : scene->targets())
+            {
+                if(auto tile = tileOf(target); tile)
+                    changes.tiles.insert(tile);
+                else
+                    changes.database = true;
+            }
+            changes.database |= scene->topology();
+        }
+        for (int i = 0; i < command->childCount(); ++i)
+            collect(command->child(i));
     };
-    LambdaVisitor<decltype (removeParents), vsg::Node> lvmp(removeParents);
+    auto index = undoStack->index();
+    for (int i = std::min(clean, index); i < std::max(clean, index); ++i)
+        collect(undoStack->command(i));
+    return changes;
+}
+
+static bool writeSnapshot(const DatabaseManager::Snapshot &snapshot, vsg::ref_ptr<vsg::Options> options, vsg::ref_ptr<vsg::Options> binary)
+{
+    auto ext = QString::fromStdString(vsg::lowerCaseFileExtension(snapshot.path.toStdString()));
+
+    QByteArray bytes;
+    if(ext == CompressedTile::EXTENSION)
+        bytes = CompressedTile::compress(snapshot.bytes.data(), snapshot.bytes.size());
+    else if(ext == ".vsgb")
+        bytes = QByteArray::fromRawData(snapshot.bytes.data(), static_cast<qsizetype>(snapshot.bytes.size()));
+    else
+    {
+        MemoryStream stream(snapshot.bytes.data(), snapshot.bytes.size());
+        vsg::VSG rw;
+        auto object = rw.read(stream, binary);
+        if(!object)
+            return false;
+        auto text = vsg::Options::create(*options);
+        text->extensionHint = ext.toStdString();
+        std::ostringstream oss;
+        if(!rw.write(object, oss, text))
+            return false;
+        bytes = QByteArray::fromStdString(oss.str());
+    }
 
-    tilesModel->getRoot()->accept(lv);
-    tilesModel->getRoot()->accept(lvmp);
+    // replaces the file only on commit, a failed save leaves the previous version intact
+    QSaveFile file(snapshot.path);
+    if(!file.open(QIODevice::WriteOnly) || file.write(bytes) != bytes.size() || !file.commit())
+        return false;
+    if(!snapshot.replaces.isEmpty())
+        QFile::remove(snapshot.replaces);
+    return true;
+}
+
+// tiles of a save waiting for their snapshot; the workers take them one by one and an edit
+// takes the rest on the gui thread, so nothing is read while it changes
+struct DatabaseManager::PendingSnapshots
+{
+    std::vector<vsg::ref_ptr<vsg::Node>> nodes;
+    std::vector<Snapshot> snapshots;
+    std::function<Snapshot(const vsg::ref_ptr<vsg::Node>&)> take;
+    std::atomic<std::size_t> next = 0;
+    std::atomic<std::size_t> done = 0;
+    QMutex mutex;
+    QWaitCondition taken;
+
+    bool finished() const { return done == nodes.size(); }
+
+    void takeAll()
+    {
+        for (std::size_t i = next++; i < nodes.size(); i = next++)
+        {
+            snapshots[i] = take(nodes[i]);
+            QMutexLocker lock(&mutex);
+            if(++done == nodes.size())
+                taken.wakeAll();
+        }
+        QMutexLocker lock(&mutex);
+        while (done < nodes.size())
+            taken.wait(&mutex);
+    }
+};
+
+bool DatabaseManager::isSnapshotting() const
+{
+    return _snapshots && !_snapshots->finished();
+}
+
+void DatabaseManager::finishSnapshots()
+{
+    if(isSnapshotting())
+        _snapshots->takeAll();
+}
+
+QFuture<QStringList> DatabaseManager::writeTiles()
+{
+    // the bounds are stripped from the live graph below, a previous save must not be reading it
+    finishSnapshots();
 
     std::string path;
     if(!_database->getValue(app::PATH, path))
         throw DatabaseException(QObject::tr("Ошибка записи"));
 
-    vsg::write(_database, path, builder->options);
+    auto changes = unsavedChanges();
+    auto writeDatabase = changes.all || changes.database;
 
-    auto write = [options=builder->options](const auto node)
+    // tiles that were never loaded are unchanged on disk
+    auto tiles = vsg::Group::create();
+    QHash<QString, QString> replaced;
+    for (auto &child : root->children)
     {
-        std::string path;
-        if(!node->getValue(app::PATH, path))
-            return;
-        auto ext = vsg::lowerCaseFileExtension(path);
-        if (ext == ".vsgt" || ext == ".vsgb")
+        std::string tilePath;
+        if((changes.all || changes.tiles.contains(child.get())) && !TileLoader::isStub(child) && child->getValue(app::PATH, tilePath))
         {
-            vsg::VSG rw;
-            rw.write(node, path, options);
+            auto ext = vsg::lowerCaseFileExtension(tilePath);
+            if (ext != ".vsgt" && ext != ".vsgb" && ext != CompressedTile::EXTENSION)
+                continue;
+            tiles->addChild(child);
+
+            // the tile is renamed now, the old file is removed once the new one is written
+            if(compressTiles && ext != CompressedTile::EXTENSION)
+            {
+                auto from = QString::fromStdString(tilePath);
+                auto to = CompressedTile::compressedPath(from);
+                child->setValue(app::PATH, to.toStdString());
+                replaced.insert(to, from);
+            }
         }
+    }
+
+    auto removeBounds = [](vsg::VertexIndexDraw& object)
+    {
+        object.removeObject("bound");
     };
+    LambdaVisitor<decltype (removeBounds), vsg::VertexIndexDraw> lv(removeBounds);
 
-    auto future = QtConcurrent::map(root->children.begin(), root->children.end(), write);
-    future.waitForFinished();
+    tiles->accept(lv);
+    if(writeDatabase)
+        _database->accept(lv);
 
     undoStack->setClean();
-    vsg::visit<ParentIndexer>(tilesModel->getRoot());
+    _dirtyTiles.clear();
+    _dirtyDatabase = false;
+
+    QHash<QString, vsg::Node*> owners;
+    for (auto &tile : tiles->children)
+    {
+        std::string tilePath;
+        tile->getValue(app::PATH, tilePath);
+        owners.insert(QString::fromStdString(tilePath), tile);
+    }
+    if(writeDatabase)
+        owners.insert(QString::fromStdString(path), nullptr);
+
+    // tiles that were not written keep their entries from the previous index, the one on disk
+    // when the route was opened eagerly, so a save of some tiles never drops the others
+    QSet<const vsg::Node*> written(tiles->children.begin(), tiles->children.end());
+    auto routeDir = QFileInfo(QString::fromStdString(path)).absoluteDir();
+    auto previousIndex = routeIndex ? routeIndex : RouteIndex::read(routeDir);
+    auto index = RouteIndex::create(routeDir);
+    auto carried = [&previousIndex](const QString &file) -> const RouteIndex::Tile*
+    {
+        return previousIndex ? previousIndex->find(file) : nullptr;
+    };
+
+    QSet<QString> open;
+    for (const auto &from : std::as_const(replaced))
+        open.insert(QFileInfo(from).fileName());
+    for (auto &child : root->children)
+    {
+        std::string tilePath;
+        if(!child->is_compatible(typeid (vsg::Switch)) || !child->getValue(app::PATH, tilePath))
+            continue;
+        auto file = QString::fromStdString(tilePath);
+        open.insert(QFileInfo(file).fileName());
+        auto previous = !written.contains(child.get()) ? carried(file) : nullptr;
+        if(previous)
+        {
+            auto tile = *previous;
+            tile.entries = previousIndex->entries(*previous);
+            index->addTile(tile);
+        }
+        else
+            index->addTile(file, child);
+    }
+    // tiles not opened in this session, as long as their files did not change since
+    if(previousIndex)
+    {
+        for (const auto &tile : previousIndex->tiles())
+        {
+            if(open.contains(tile.file))
+                continue;
+            if(auto previous = carried(routeDir.filePath(tile.file)); previous)
+            {
+                auto kept = *previous;
+                kept.entries = previousIndex->entries(*previous);
+                index->addTile(kept);
+            }
+        }
+    }
+
+    // the snapshot is an in-memory binary copy taken on the workers, the graph is not changed for it:
+    // compressed textures are written as their sources straight from the serializer
+    auto binary = vsg::Options::create(*builder->options);
+    binary->extensionHint = ".vsgb";
+    auto sources = std::make_shared<TextureCompressor::Sources>(tiles);
+
+    auto pending = std::make_shared<PendingSnapshots>();
+    pending->nodes = tiles->children;
+    if(writeDatabase)
+        pending->nodes.push_back(_database);
+    pending->snapshots.resize(pending->nodes.size());
+    pending->take = [binary, sources](const vsg::ref_ptr<vsg::Node> &node)
+    {
+        std::string path;
+        node->getValue(app::PATH, path);
+        return Snapshot{QString::fromStdString(path), sources->write(node, binary)};
+    };
+    _snapshots = pending;
+
+    // saves are written one after another so a later one never loses to an earlier one
+    _writing = QtConcurrent::run([previous=_writing, pending, replaced, index, options=builder->options, binary]()
+    {
+        std::vector<int> workers(static_cast<std::size_t>(std::max(1, QThreadPool::globalInstance()->maxThreadCount())));
+        QtConcurrent::blockingMap(workers, [pending](int)
+        {
+            pending->takeAll();
+        });
+        auto snapshots = std::move(pending->snapshots);
+        for (auto &snapshot : snapshots)
+            snapshot.replaces = replaced.value(snapshot.path);
+
+        previous.waitForFinished();
+
+        auto failed = QtConcurrent::blockingMapped<QStringList>(snapshots, [options, binary](const Snapshot &snapshot)
+        {
+            return writeSnapshot(snapshot, options, binary) ? QString() : snapshot.path;
+        });
+        failed.removeAll(QString());
+
+        // the index records the files as they are after this save
+        for (const auto &snapshot : snapshots)
+            index->refresh(snapshot.path);
+        if(failed.isEmpty() && !index->write())
+            failed << index->path();
+        return failed;
+    });
+
+    // the manager is kept alive until the result is applied
+    return _writing.then(qApp, [self=vsg::ref_ptr<DatabaseManager>(this), index, owners, replaced](QStringList failed)
+    {
+        // what could not be written is unsaved again
+        for (const auto &file : failed)
+        {
+            if(auto owner = owners.find(file); owner != owners.end() && owner.value())
+            {
+                self->_dirtyTiles.insert(owner.value());
+                // the old file is still there, so the tile keeps its name
+                if(auto from = replaced.find(file); from != replaced.end())
+                    owner.value()->setValue(app::PATH, from.value().toStdString());
+            }
+            else
+                self->_dirtyDatabase = true;
+        }
+        if(failed.isEmpty())
+            self->routeIndex = index;
+        return failed;
+    });
+}
+
+bool DatabaseManager::waitForSave()
+{
+    _writing.waitForFinished();
+    return _writing.resultCount() == 0 || _writing.result().isEmpty();
 }
 
 void DatabaseManager::compile()
@@ -139,8 +716,10 @@ void DatabaseManager::compile()
     Q_ASSERT(viewer);
 
     auto res = viewer->compileManager->compile(_stdAxis);
+    CompileStats::record(_stdAxis);
     vsg::updateViewer(*viewer, res);
     res = viewer->compileManager->compile(_stdWireBox);
+    CompileStats::record(_stdWireBox);
     vsg::updateViewer(*viewer, res);
 
     _compiled = true;
@@ -5,6 +5,8 @@
 #include <QDirIterator>
 #include <QFileSystemWatcher>
 #include <QException>
+#include <QSet>
+#include <memory>
 #include "SceneModel.h"
 #include <QSettings>
 #include <QProgressBar>
@@ -12,8 +14,12 @@
 #include <vsgXchange/all.h>
 #include <QtConcurrent>
 #include "SceneObjectVisitor.h"
+#include "TileLoader.h"
+#include "RouteIndex.h"
+#include "RouteTypes.h"
 #include <vsg/nodes/MatrixTransform.h>
 #include <vsg/nodes/Switch.h>
+#include <vsg/traversals/Intersector.h>
 
 namespace route {
     class Topology;
@@ -21,30 +27,6 @@ namespace route {
 
 class Manipulator;
 
-class DatabaseException
-{
-public:
-    DatabaseException(const QString &path)
-        : err_path(path)
-    {
-    }
-    QString getErrPath() { return err_path; }
-private:
-    QString err_path;
-};
-
-class PointsGroup : public vsg::Inherit<vsg::Group, PointsGroup>
-{
-public:
-    PointsGroup() : vsg::Inherit<vsg::Group, PointsGroup>() {}
-
-    void read(vsg::Input& input) override { vsg::Node::read(input); }
-    void write(vsg::Output& output) const override { vsg::Node::write(output); }
-
-protected:
-    virtual ~PointsGroup(){}
-};
-
 class DatabaseManager : public vsg::Inherit<vsg::Object, DatabaseManager>
 {
 public:
@@ -55,7 +37,30 @@ public:
     void setViewer(vsg::ref_ptr<vsg::Viewer> viewer);
 
     vsg::ref_ptr<vsg::Group> getDatabase() const noexcept;
+
+    void setPendingTiles(const QStringList &tiles);
+    bool hasPendingTiles() const noexcept { return !_pendingTiles.empty(); }
     QFuture<void> loadTiles(QProgressBar *bar = nullptr);
+
+    void requestTile(const QModelIndex &index);
+    void requestTile(vsg::Switch *stub);
+    void loadTile(vsg::Switch *stub);
+    void requestTilesNear(const vsg::dvec3 &eye);
+    void loadIntersectedTiles(vsg::Intersector &intersector);
+    vsg::dbox stubBounds() const;
+
+    std::size_t residentBytes() const;
+    void evictTiles();
+
+    std::size_t sharedBytes = 0;
+    int sharedStates = 0;
+
+    // changed tiles are saved as .vsgz
+    bool compressTiles = false;
+
+    double lazyDistance = 0.0;
+    std::size_t tilesBudget = 0;
+
     vsg::ref_ptr<vsg::Node> getStdWireBox();
     vsg::ref_ptr<vsg::Node> getStdAxis();
 
@@ -69,17 +74,72 @@ public:
 
     vsg::ref_ptr<vsg::Group> root;
 
+    vsg::ref_ptr<TileLoader> loader;
+    vsg::ref_ptr<RouteIndex> routeIndex;
+
     SceneModel *tilesModel;
 
-    void writeTiles();
+    // for changes that bypass the undo stack, like painting and interlocking
+    void markDirty(const vsg::Node *node, bool topology = false);
+
+    struct Snapshot
+    {
+        QString path;
+        std::string bytes;
+        // file the tile was read from when it is saved in another format
+        QString replaces;
+    };
+    // returns at once, the future holds the files that could not be written
+    QFuture<QStringList> writeTiles();
+    bool isSnapshotting() const;
+    // takes the snapshots the workers have not taken yet and waits for the rest,
+    // to be called before the scene is edited while a save is running
+    void finishSnapshots();
+    // false if the last save left files unwritten
+    bool waitForSave();
 
 private:
     void compile();
     bool _compiled = false;
 
+    void attachTile(vsg::Switch *stub, vsg::ref_ptr<vsg::Node> tile);
+    void touchTile(const vsg::Node *tile);
+    const vsg::Node *tileOf(const vsg::Node *node) const;
+    QSet<const vsg::Node*> pinnedTiles() const;
+
+    struct Changes
+    {
+        QSet<const vsg::Node*> tiles;
+        bool database = false;
+        bool all = false;
+    };
+    Changes unsavedChanges() const;
+
+    QSet<const vsg::Node*> _dirtyTiles;
+    bool _dirtyDatabase = false;
+    QFuture<QStringList> _writing;
+    struct PendingSnapshots;
+    std::shared_ptr<PendingSnapshots> _snapshots;
+
+    QSet<const vsg::Node*> _requestedTiles;
+
+    struct ResidentTile
+    {
+        vsg::dbox bounds;
+        std::size_t bytes = 0;
+        quint64 used = 0;
+    };
+    QHash<const vsg::Node*, ResidentTile> _residentTiles;
+    quint64 _tick = 0;
+    vsg::dvec3 _eye = {};
+
+    std::vector<vsg::Switch::Children> _retiredTiles;
+
     vsg::ref_ptr<vsg::Group> _database;
     vsg::ref_ptr<vsg::Node> _stdWireBox;
     vsg::ref_ptr<vsg::Group> _stdAxis;
+
+    QStringList _pendingTiles;
 };
 
 #endif // DATABASEMANAGER_H
@@ -0,0 +1,551 @@
+#include "EditJournal.h"
+#include "DatabaseManager.h"
+#include "undo-redo.h"
+#include "LambdaVisitor.h"
+#include "MemoryStream.h"
+#include "CompileStats.h"
+#include <QDataStream>
+#include <QFileInfo>
+#include <algorithm>
+#include <sstream>
+#include <vsg/io/VSG.h>
+#include <vsg/nodes/VertexIndexDraw.h>
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+    constexpr quint32 MAGIC = 0x454a524e; // "EJRN"
+    constexpr quint32 VERSION = 2;
+    constexpr qint64 HEADER_SIZE = 8;
+    // size and checksum in front of each entry
+    constexpr qint64 FRAME_HEADER = 6;
+
+    // entries are synced in small batches, or after a short pause in editing
+    constexpr int SYNC_BATCH = 16;
+    constexpr int SYNC_DELAY = 500;
+
+    constexpr const char* FILE_NAME = "edits.journal";
+}
+
+EditJournal::EditJournal(DatabaseManager *database, const QDir &routeDir, QObject *parent)
+    : QObject(parent)
+    , _database(database)
+    , _file(filePath(routeDir))
+{
+    _syncTimer.setSingleShot(true);
+    _syncTimer.setInterval(SYNC_DELAY);
+    connect(&_syncTimer, &QTimer::timeout, this, &EditJournal::sync);
+}
+EditJournal::~EditJournal()
+{
+    sync();
+}
+
+QString EditJournal::filePath(const QDir &routeDir)
+{
+    return routeDir.filePath(FILE_NAME);
+}
+
+int EditJournal::entryCount(const QString &path)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly))
+        return 0;
+    return static_cast<int>(readEntries(file).size());
+}
+
+void EditJournal::setUndoStack(QUndoStack *stack)
+{
+    _undoStack = stack;
+    _journaled = stack->index();
+    connect(stack, &QUndoStack::indexChanged, this, &EditJournal::indexChanged);
+}
+
+QList<QByteArray> EditJournal::readEntries(QFile &file)
+{
+    QList<QByteArray> entries;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0, version = 0;
+    in >> magic >> version;
+    if(magic != MAGIC || version != VERSION)
+        return entries;
+
+    // a crash can leave the last entry torn, everything before it is intact
+    while(!in.atEnd())
+    {
+        quint32 size = 0;
+        quint16 checksum = 0;
+        in >> size >> checksum;
+        if(in.status() != QDataStream::Ok || size > file.bytesAvailable())
+            break;
+        QByteArray payload(static_cast<qsizetype>(size), Qt::Uninitialized);
+        if(in.readRawData(payload.data(), static_cast<int>(size)) != static_cast<int>(size) || qChecksum(payload) != checksum)
+            break;
+        entries.push_back(payload);
+    }
+    return entries;
+}
+
+bool EditJournal::open()
+{
+    if(_file.isOpen())
+        return true;
+    if(!_file.open(QIODevice::ReadWrite))
+        return false;
+
+    // appends go after the last intact entry
+    auto entries = readEntries(_file);
+    qint64 end = HEADER_SIZE;
+    for (const auto &entry : entries)
+        end += FRAME_HEADER + entry.size();
+
+    _file.seek(0);
+    QDataStream stream(&_file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0, version = 0;
+    stream >> magic >> version;
+    if(magic != MAGIC || version != VERSION)
+    {
+        _file.resize(0);
+        _file.seek(0);
+        stream.resetStatus();
+        stream << MAGIC << VERSION;
+    }
+    else
+        _file.resize(end);
+    return _file.seek(_file.size());
+}
+
+void EditJournal::append(const QByteArray &payload)
+{
+    if(!open())
+        return;
+
+    QDataStream out(&_file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << static_cast<quint32>(payload.size()) << qChecksum(payload);
+    out.writeRawData(payload.constData(), static_cast<int>(payload.size()));
+
+    if(++_pending >= SYNC_BATCH)
+        sync();
+    else if(!_syncTimer.isActive())
+        _syncTimer.start();
+}
+
+void EditJournal::sync()
+{
+    _syncTimer.stop();
+    if(!_file.isOpen() || _pending == 0)
+        return;
+    _file.flush();
+#ifdef Q_OS_WIN
+    _commit(_file.handle());
+#else
+    fsync(_file.handle());
+#endif
+    _pending = 0;
+}
+
+qint64 EditJournal::checkpoint()
+{
+    sync();
+    return _file.isOpen() ? _file.size() : HEADER_SIZE;
+}
+
+void EditJournal::truncate(qint64 checkpoint)
+{
+    sync();
+    if(!_file.isOpen())
+        return;
+
+    // the edits made while the save was written are kept, they apply to the saved tiles
+    _file.seek(checkpoint);
+    auto tail = _file.readAll();
+    _file.close();
+
+    QFile part(_file.fileName() + ".part");
+    if(part.open(QIODevice::WriteOnly))
+    {
+        QDataStream out(&part);
+        out.setVersion(QDataStream::Qt_6_0);
+        out << MAGIC << VERSION;
+        out.writeRawData(tail.constData(), static_cast<int>(tail.size()));
+        part.close();
+        QFile::remove(_file.fileName());
+        part.rename(_file.fileName());
+    }
+    open();
+}
+
+void EditJournal::discard()
+{
+    _syncTimer.stop();
+    _pending = 0;
+    _file.close();
+    _file.remove();
+}
+
+void EditJournal::indexChanged(int index)
+{
+    if(_replaying)
+        return;
+
+    if(index > _journaled)
+    {
+        for (int i = _journaled; i < index; ++i)
+            record(_undoStack->command(i), false);
+    }
+    else if(index < _journaled)
+    {
+        for (int i = _journaled - 1; i >= index; --i)
+            record(_undoStack->command(i), true);
+    }
+    // the same index means the last command merged another one
+    else if(index > 0)
+        record(_undoStack->command(index - 1), false);
+
+    _journaled = index;
+}
+
+void EditJournal::record(const QUndoCommand *command, bool undone)
+{
+    auto count = command->childCount();
+    auto scene = dynamic_cast<const SceneCommand*>(command);
+    if(!scene && count != 0)
+    {
+        // everything is located in the tree the macro leaves behind, so edits that keep the rows
+        // are replayed after those that move them
+        auto movesRows = [](const QUndoCommand *child)
+        {
+            auto scene = dynamic_cast<const SceneCommand*>(child);
+            return scene ? scene->movesRows() : child->childCount() != 0;
+        };
+        for (bool rows : {true, false})
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                auto child = command->child(undone ? count - 1 - i : i);
+                if(movesRows(child) == rows)
+                    record(child, undone);
+            }
+        }
+        return;
+    }
+
+    if(!scene || !scene->journal(*this, undone))
+    {
+        // replay has to stop here, whatever comes after may depend on it
+        QByteArray payload;
+        QDataStream out(&payload, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_6_0);
+        out << static_cast<quint8>(Barrier) << command->text();
+        append(payload);
+    }
+}
+
+bool EditJournal::append(Operation operation, const vsg::Node *target, const std::function<void(QDataStream&)> &data,
+                         const QSet<const vsg::Node*> &absent)
+{
+    QString tile;
+    QList<qint32> rows;
+    if(!target || !locate(target, tile, rows, absent))
+        return false;
+
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << static_cast<quint8>(operation) << tile << rows;
+    data(out);
+    append(payload);
+    return true;
+}
+
+bool EditJournal::position(const vsg::Node *target, const vsg::dvec3 &position)
+{
+    return append(Position, target, [&position](QDataStream &out)
+    {
+        out << position.x << position.y << position.z;
+    });
+}
+
+bool EditJournal::rotation(const vsg::Node *target, const vsg::dquat &rotation)
+{
+    return append(Rotation, target, [&rotation](QDataStream &out)
+    {
+        out << rotation.x << rotation.y << rotation.z << rotation.w;
+    });
+}
+
+bool EditJournal::name(const vsg::Node *target, const std::string &name)
+{
+    return append(Name, target, [&name](QDataStream &out)
+    {
+        out << QString::fromStdString(name);
+    });
+}
+
+bool EditJournal::trajectoryCoord(const vsg::Node *target, double coord)
+{
+    return append(TrajectoryCoord, target, [coord](QDataStream &out)
+    {
+        out << coord;
+    });
+}
+
+bool EditJournal::transform(const vsg::Node *target, const vsg::dvec3 &position, const vsg::dmat4 &localToWorld)
+{
+    return append(Transform, target, [&position, &localToWorld](QDataStream &out)
+    {
+        out << position.x << position.y << position.z;
+        for (int c = 0; c < 4; ++c)
+            for (int r = 0; r < 4; ++r)
+                out << localToWorld[c][r];
+    });
+}
+
+bool EditJournal::insert(const vsg::Node *group, vsg::Node *node, int row, uint64_t mask)
+{
+    auto removeBounds = [](vsg::VertexIndexDraw& object)
+    {
+        object.removeObject("bound");
+    };
+    LambdaVisitor<decltype (removeBounds), vsg::VertexIndexDraw> lv(removeBounds);
+    node->accept(lv);
+
+    auto binary = vsg::Options::create(*_database->builder->options);
+    binary->extensionHint = ".vsgb";
+    std::ostringstream oss;
+    vsg::VSG rw;
+    rw.write(vsg::ref_ptr<vsg::Node>(node), oss, binary);
+
+    auto bytes = oss.str();
+    return append(Insert, group, [&bytes, row, mask](QDataStream &out)
+    {
+        out << QByteArray::fromRawData(bytes.data(), static_cast<qsizetype>(bytes.size())) << static_cast<qint32>(row) << static_cast<quint64>(mask);
+    });
+}
+
+bool EditJournal::remove(const vsg::Node *group, int row, const QSet<const vsg::Node*> &absent)
+{
+    return append(Remove, group, [row](QDataStream &out)
+    {
+        out << static_cast<qint32>(row);
+    }, absent);
+}
+
+bool EditJournal::locatable(const vsg::Node *node) const
+{
+    QString tile;
+    QList<qint32> rows;
+    return node && locate(node, tile, rows);
+}
+
+bool EditJournal::locate(const vsg::Node *node, QString &tile, QList<qint32> &rows, const QSet<const vsg::Node*> &absent) const
+{
+    auto model = _database->tilesModel;
+    while(node)
+    {
+        auto parent = model->parentNode(node);
+        if(!parent)
+            return false;
+        if(parent == _database->root.get())
+        {
+            std::string path;
+            if(!node->getValue(app::PATH, path))
+                return false;
+            tile = QFileInfo(QString::fromStdString(path)).fileName();
+            std::reverse(rows.begin(), rows.end());
+            return true;
+        }
+        auto row = model->index(node, parent).row();
+        for (auto other : absent)
+            if(model->parentNode(other) == parent && model->index(other, parent).row() < row)
+                row--;
+        rows.push_back(row);
+        node = parent;
+    }
+    return false;
+}
+
+vsg::Node *EditJournal::resolve(const QString &tile, const QList<qint32> &rows) const
+{
+    auto model = _database->tilesModel;
+    for (auto &child : _database->root->children)
+    {
+        std::string path;
+        if(!child->getValue(app::PATH, path) || QFileInfo(QString::fromStdString(path)).fileName() != tile)
+            continue;
+
+        if(auto stub = child.cast<vsg::Switch>(); stub && TileLoader::isStub(stub))
+            _database->loadTile(stub);
+
+        auto index = model->index(child);
+        for (auto row : rows)
+        {
+            if(row < 0 || row >= model->childRows(index))
+                return nullptr;
+            index = model->index(row, 0, index);
+        }
+        return static_cast<vsg::Node*>(index.internalPointer());
+    }
+    return nullptr;
+}
+
+int EditJournal::replay(int *total)
+{
+    if(total)
+        *total = 0;
+    if(!_file.exists() || !_file.open(QIODevice::ReadOnly))
+        return 0;
+    auto entries = readEntries(_file);
+    _file.close();
+
+    if(total)
+        *total = static_cast<int>(entries.size());
+    if(entries.isEmpty())
+        return 0;
+
+    // the edits are already in the journal, replaying must not add them again
+    _replaying = true;
+    _undoStack->beginMacro(tr("Восстановлены несохраненные изменения"));
+    int applied = 0;
+    for (const auto &entry : entries)
+    {
+        if(!apply(entry))
+            break;
+        applied++;
+    }
+    _undoStack->endMacro();
+    _replaying = false;
+    _journaled = _undoStack->index();
+
+    // whatever could not be replayed is dropped, the journal matches the tree again
+    if(applied != entries.size())
+    {
+        auto kept = HEADER_SIZE;
+        for (int i = 0; i < applied; ++i)
+            kept += FRAME_HEADER + entries[i].size();
+        if(_file.open(QIODevice::ReadWrite))
+        {
+            _file.resize(kept);
+            _file.close();
+        }
+    }
+    return applied;
+}
+
+bool EditJournal::apply(const QByteArray &payload)
+{
+    QDataStream in(payload);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    quint8 operation = Barrier;
+    QString tile;
+    QList<qint32> rows;
+    in >> operation;
+    if(operation == Barrier)
+        return false;
+    in >> tile >> rows;
+
+    auto target = resolve(tile, rows);
+    if(!target || in.status() != QDataStream::Ok)
+        return false;
+
+    auto model = _database->tilesModel;
+    switch (operation) {
+    case Position:
+    {
+        vsg::dvec3 position;
+        in >> position.x >> position.y >> position.z;
+        auto object = target->cast<route::SceneObject>();
+        if(!object)
+            return false;
+        _undoStack->push(new MoveObject(object, position));
+        break;
+    }
+    case Rotation:
+    {
+        vsg::dquat rotation;
+        in >> rotation.x >> rotation.y >> rotation.z >> rotation.w;
+        auto object = target->cast<route::SceneObject>();
+        if(!object)
+            return false;
+        _undoStack->push(new RotateObject(object, rotation));
+        break;
+    }
+    case Name:
+    {
+        QString name;
+        in >> name;
+        _undoStack->push(new RenameObject(model, target, name));
+        break;
+    }
+    case TrajectoryCoord:
+    {
+        double coord = 0.0;
+        in >> coord;
+        auto transform = target->cast<vsg::MatrixTransform>();
+        if(!transform)
+            return false;
+        _undoStack->push(new MoveObjectOnTraj(model, transform, coord));
+        break;
+    }
+    case Insert:
+    {
+        QByteArray bytes;
+        in >> bytes;
+        auto binary = vsg::Options::create(*_database->builder->options);
+        binary->extensionHint = ".vsgb";
+        MemoryStream stream(bytes.constData(), static_cast<std::size_t>(bytes.size()));
+        vsg::VSG rw;
+        auto node = rw.read(stream, binary).cast<vsg::Node>();
+        if(!node)
+            return false;
+
+        qint32 row = -1;
+        quint64 mask = route::SceneObjects;
+        in >> row >> mask;
+        if(row > model->childRows(model->index(target)))
+            return false;
+
+        auto result = _database->viewer->compileManager->compile(node);
+        CompileStats::record(node);
+        vsg::updateViewer(*_database->viewer, result);
+        _undoStack->push(new AddSceneObject(model, target, node, row, mask));
+        break;
+    }
+    case Transform:
+    {
+        vsg::dvec3 position;
+        vsg::dmat4 localToWorld;
+        in >> position.x >> position.y >> position.z;
+        for (int c = 0; c < 4; ++c)
+            for (int r = 0; r < 4; ++r)
+                in >> localToWorld[c][r];
+        auto object = target->cast<route::SceneObject>();
+        if(!object)
+            return false;
+        _undoStack->push(new ApplyTransformCalculation(object, position, localToWorld));
+        break;
+    }
+    case Remove:
+    {
+        qint32 row = 0;
+        in >> row;
+        auto group = model->index(target);
+        if(row < 0 || row >= model->childRows(group))
+            return false;
+        _undoStack->push(new RemoveNode(model, model->index(row, 0, group)));
+        break;
+    }
+    default:
+        return false;
+    }
+    return in.status() == QDataStream::Ok;
+}
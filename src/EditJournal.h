@@ -0,0 +1,93 @@
+#ifndef EDITJOURNAL_H
+#define EDITJOURNAL_H
+
+#include <QObject>
+#include <QFile>
+#include <QDir>
+#include <QTimer>
+#include <QUndoStack>
+#include <QSet>
+#include <functional>
+#include <vsg/nodes/Node.h>
+#include <vsg/maths/quat.h>
+#include <vsg/maths/mat4.h>
+#include "sceneobjects.h"
+
+class DatabaseManager;
+class QDataStream;
+
+// append-only log of the state commands leave behind, so unsaved edits survive a crash;
+// objects are addressed by tile file and tree rows, which hold for the tiles as saved
+class EditJournal : public QObject
+{
+    Q_OBJECT
+public:
+    EditJournal(DatabaseManager *database, const QDir &routeDir, QObject *parent = nullptr);
+    ~EditJournal();
+
+    static QString filePath(const QDir &routeDir);
+    static int entryCount(const QString &path);
+
+    void setUndoStack(QUndoStack *stack);
+
+    // pushes the journaled edits as one macro, stops where an edit can't be found or replayed
+    int replay(int *total = nullptr);
+
+    // everything up to the returned offset is on disk
+    qint64 checkpoint();
+    // drops what was journaled before the checkpoint of a save that succeeded
+    void truncate(qint64 checkpoint);
+    void discard();
+
+    bool position(const vsg::Node *target, const vsg::dvec3 &position);
+    bool rotation(const vsg::Node *target, const vsg::dquat &rotation);
+    bool name(const vsg::Node *target, const std::string &name);
+    bool trajectoryCoord(const vsg::Node *target, double coord);
+    bool transform(const vsg::Node *target, const vsg::dvec3 &position, const vsg::dmat4 &localToWorld);
+    // appends for -1, the mask applies under a switch
+    bool insert(const vsg::Node *group, vsg::Node *node, int row = -1, uint64_t mask = route::SceneObjects);
+    // the group is located as if the absent nodes were not in the tree yet
+    bool remove(const vsg::Node *group, int row, const QSet<const vsg::Node*> &absent = {});
+    // whether entries for the node can be written, to check a command's nodes before writing any
+    bool locatable(const vsg::Node *node) const;
+
+private:
+    enum Operation : quint8
+    {
+        Position,
+        Rotation,
+        Name,
+        TrajectoryCoord,
+        Insert,
+        Remove,
+        Barrier,
+        Transform
+    };
+
+    void indexChanged(int index);
+    void record(const QUndoCommand *command, bool undone);
+
+    bool append(Operation operation, const vsg::Node *target, const std::function<void(QDataStream&)> &data,
+                const QSet<const vsg::Node*> &absent = {});
+    void append(const QByteArray &payload);
+    void sync();
+    bool open();
+
+    bool locate(const vsg::Node *node, QString &tile, QList<qint32> &rows, const QSet<const vsg::Node*> &absent = {}) const;
+    vsg::Node *resolve(const QString &tile, const QList<qint32> &rows) const;
+    bool apply(const QByteArray &payload);
+
+    static QList<QByteArray> readEntries(QFile &file);
+
+    DatabaseManager *_database;
+    QUndoStack *_undoStack = nullptr;
+
+    QFile _file;
+    QTimer _syncTimer;
+    int _pending = 0;
+
+    int _journaled = 0;
+    bool _replaying = false;
+};
+
+#endif // EDITJOURNAL_H
@@ -11,8 +11,6 @@ InterlockDialog::InterlockDialog(DatabaseManager *db, QWidget *parent)
 
     _sorter = new TilesSorter(this);
     _sorter->setSourceModel(db->tilesModel);
-    _sorter->setFilterKeyColumn(1);
-    _sorter->setFilterWildcard("*");
     ui->trackView->setModel(_sorter);
 
     ui->endList->setEnabled(false);
@@ -30,7 +28,7 @@ InterlockDialog::InterlockDialog(DatabaseManager *db, QWidget *parent)
     ui->cmdList->setModel(_cmdModel);
     ui->trajsList->setModel(_trjModel);
 
-    connect(ui->searchLine, &QLineEdit::textChanged, _sorter, &TilesSorter::setFilterWildcard);
+    connect(ui->searchLine, &QLineEdit::textChanged, _sorter, &TilesSorter::setFilterPattern);
     /*connect(ui->tilesView->selectionModel(), &QItemSelectionModel::selectionChanged, sorter, &TilesSorter::viewSelectSlot);
     connect(ui->tilesView, &QTreeView::doubleClicked, sorter, &TilesSorter::viewDoubleClicked);
     connect(sorter, &TilesSorter::viewSelectSignal, ui->tilesView->selectionModel(),
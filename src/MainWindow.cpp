@@ -6,7 +6,11 @@
 #include <QColorDialog>
 #include <QErrorMessage>
 #include <QMessageBox>
+#include <QLabel>
+#include <QTimer>
+#include <QApplication>
 #include "undo-redo.h"
+#include "CompileStats.h"
 #include "InterlockDialog.h"
 #include "LambdaVisitor.h"
 #include "ParentVisitor.h"
@@ -16,10 +20,11 @@
 
 
 
-MainWindow::MainWindow(vsg::ref_ptr<DatabaseManager> dbm, QWidget *parent)
+MainWindow::MainWindow(vsg::ref_ptr<DatabaseManager> dbm, bool replay, QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
     , database(dbm)
+    , replayJournal(replay)
 {
 
     ui->setupUi(this);
@@ -28,6 +33,11 @@ MainWindow::MainWindow(vsg::ref_ptr<DatabaseManager> dbm, QWidget *parent)
 
     database->setUndoStack(new QUndoStack(this));
 
+    std::string databasePath;
+    database->getDatabase()->getValue(app::PATH, databasePath);
+    journal = new EditJournal(database, QFileInfo(QString::fromStdString(databasePath)).absoluteDir(), this);
+    journal->setUndoStack(database->undoStack);
+
     initializeTools();
 
     undoView = new QUndoView(database->undoStack, ui->tabWidget);
@@ -40,19 +50,7 @@ MainWindow::MainWindow(vsg::ref_ptr<DatabaseManager> dbm, QWidget *parent)
     {
         auto selected = sorter->mapSelectionToSource(ui->tilesView->selectionModel()->selection()).indexes();
         if(!selected.empty())
-        {
-            if(selected.size() != 1)
-            {
-                std::sort(selected.begin(), selected.end(), [](auto lhs, auto rhs){ return lhs.row() > rhs.row(); });
-                database->undoStack->beginMacro("Удалены объекты");
-            }
-
-            for (const auto &index : selected)
-                    database->undoStack->push(new RemoveNode(database->tilesModel, index));
-
-            if(selected.size() != 1)
-                database->undoStack->endMacro();
-        }
+            database->undoStack->push(new RemoveNodes(database->tilesModel, selected));
         else
             ui->statusbar->showMessage(tr("Выберите объекты, которые нужно удалить"), 3000);
     });
@@ -64,12 +62,9 @@ MainWindow::MainWindow(vsg::ref_ptr<DatabaseManager> dbm, QWidget *parent)
             database->undoStack->beginMacro(tr("Создан слой"));
             auto group = vsg::Group::create();
             auto parent = selected.front().parent();
-            for (const auto &index : selected)
-            {
-                Q_ASSERT(index.isValid());
-                group->children.emplace_back(static_cast<vsg::Node*>(index.internalPointer()));
-                database->undoStack->push(new RemoveNode(database->tilesModel, index));
-            }
+            auto remove = new RemoveNodes(database->tilesModel, selected);
+            database->undoStack->push(remove);
+            group->children = remove->removed();
             database->undoStack->push(new AddSceneObject(database->tilesModel, parent, group));
             database->undoStack->endMacro();
         }
@@ -87,9 +82,7 @@ MainWindow::MainWindow(vsg::ref_ptr<DatabaseManager> dbm, QWidget *parent)
             auto parent = static_cast<vsg::Node*>(parentIndex.internalPointer());
             Q_ASSERT(parent);
 
-            ParentTracer pt;
-            parent->accept(pt);
-            auto ltw = vsg::computeTransform(pt.nodePath);
+            auto ltw = vsg::computeTransform(database->tilesModel->nodePath(parent));
             auto wtl = vsg::inverse(ltw);
 
             auto node = static_cast<vsg::Node*>(front.internalPointer());
@@ -107,15 +100,10 @@ MainWindow::MainWindow(vsg::ref_ptr<DatabaseManager> dbm, QWidget *parent)
 
             database->undoStack->beginMacro(tr("Создана группа объектов"));
 
-            std::sort(selected.begin(), selected.end(), [](auto lhs, auto rhs){ return lhs.row() > rhs.row(); });
-
-            for (const auto &index : selected)
-            {
-                Q_ASSERT(index.isValid());
-                auto object = static_cast<vsg::Node*>(index.internalPointer());
-                group->children.emplace_back(object);
-                database->undoStack->push(new RemoveNode(database->tilesModel, index));
-            }
+            auto remove = new RemoveNodes(database->tilesModel, selected);
+            database->undoStack->push(remove);
+            auto removed = remove->removed();
+            group->children.insert(group->children.end(), removed.begin(), removed.end());
 
             database->undoStack->push(new AddSceneObject(database->tilesModel, parentIndex, group));
 
@@ -134,10 +122,30 @@ MainWindow::MainWindow(vsg::ref_ptr<DatabaseManager> dbm, QWidget *parent)
     {
         InterlockDialog dialog(database, this);
         dialog.exec();
+        // routes are edited in place, so the database is saved whatever was done
+        database->markDirty(nullptr, true);
     });
 }
 
 
+bool MainWindow::eventFilter(QObject *watched, QEvent *event)
+{
+    switch (event->type()) {
+    case QEvent::MouseButtonPress:
+    case QEvent::MouseButtonDblClick:
+    case QEvent::KeyPress:
+    case QEvent::ShortcutOverride:
+    case QEvent::Wheel:
+    case QEvent::Drop:
+        database->finishSnapshots();
+        qApp->removeEventFilter(this);
+        break;
+    default:
+        break;
+    }
+    return QMainWindow::eventFilter(watched, event);
+}
+
 void MainWindow::initializeTools()
 {
     QSettings settings(app::ORGANIZATION_NAME, app::APPLICATION_NAME);
@@ -171,6 +179,32 @@ void MainWindow::initializeTools()
     connect(sorter, &TilesSorter::frontSelectionChanged, cm, &ContentManager::activeGroupChanged);
 }
 
+void MainWindow::showCacheStatistics()
+{
+    QStringList messages;
+    auto loader = database->loader;
+    if(loader->cacheEnabled())
+        messages << tr("Кэш тайлов: попаданий %1, промахов %2").arg(loader->cacheHits()).arg(loader->cacheMisses());
+    if(database->sharedBytes != 0 || database->sharedStates != 0)
+        messages << tr("Общие данные тайлов: %1, наборов дескрипторов: %2")
+                    .arg(locale().formattedDataSize(static_cast<qint64>(database->sharedBytes))).arg(database->sharedStates);
+    messages << tr("Компиляций: %1, данных: %2")
+                .arg(CompileStats::calls()).arg(locale().formattedDataSize(static_cast<qint64>(CompileStats::bytes())));
+    ui->statusbar->showMessage(messages.join("; "), 5000);
+}
+
+void MainWindow::restoreEdits()
+{
+    if(!replayJournal)
+        return;
+    replayJournal = false;
+
+    int total = 0;
+    auto restored = journal->replay(&total);
+    if(total != 0)
+        ui->statusbar->showMessage(tr("Восстановлено изменений: %1 из %2").arg(restored).arg(total), 5000);
+}
+
 void MainWindow::intersection(const FoundNodes &isection)
 {
     qobject_cast<Tool*>(toolbox->currentWidget())->intersection(isection);
@@ -214,22 +248,29 @@ QWindow* MainWindow::initilizeVSGwindow()
         vsg::ComputeBounds computeBounds;
         computeBounds.traversalMask = route::SceneObjects | route::Tiles;
         database->root->accept(computeBounds);
+        if(!computeBounds.bounds.valid())
+            computeBounds.bounds = database->stubBounds();
         vsg::dvec3 centre = (computeBounds.bounds.min + computeBounds.bounds.max) * 0.5;
         //double radius = vsg::length(computeBounds.bounds.max - computeBounds.bounds.min) * 0.6;
 
         auto horizonMountainHeight = settings.value("HMH", 0.0).toDouble();
         auto nearFarRatio = settings.value("NFR", 0.0001).toDouble();
 
+        if(!database)
+            return false;
+
+        vsg::ref_ptr<vsg::EllipsoidModel> ellipsoidModel(database->getDatabase()->getObject<vsg::EllipsoidModel>("EllipsoidModel"));
+
+        // tiles are still streaming in, look at the globe until the first one arrives
+        if(!computeBounds.bounds.valid() && ellipsoidModel)
+            centre = ellipsoidModel->convertLatLongAltitudeToECEF(vsg::dvec3(0.0, 0.0, 0.0));
+
         // set up the camera
         auto lookAt = vsg::LookAt::create(centre + (vsg::normalize(centre)*1000.0), centre, vsg::dvec3(1.0, 0.0, 0.0));
         //auto lookAt = vsg::LookAt::create(centre + vsg::dvec3(0.0, -radius * 3.5, 0.0), centre, vsg::dvec3(0.0, 0.0, 1.0));
 
         vsg::ref_ptr<vsg::ProjectionMatrix> perspective;
 
-        if(!database)
-            return false;
-
-        vsg::ref_ptr<vsg::EllipsoidModel> ellipsoidModel(database->getDatabase()->getObject<vsg::EllipsoidModel>("EllipsoidModel"));
         if (ellipsoidModel)
         {
             perspective = vsg::EllipsoidPerspective::create(
@@ -284,8 +325,30 @@ QWindow* MainWindow::initilizeVSGwindow()
 
         // configure the viewers rendering backend, initialize and compile Vulkan objects, passing in ResourceHints to guide the resources allocated.
         viewer->compile(resourceHints);
+        // what was loaded with the database goes to the gpu here, later compiles are recorded where they happen
+        CompileStats::record(grahics_commandGraph);
 
-        connect(ui->actionSave, &QAction::triggered, this, [this](){ database->writeTiles(); });
+        connect(ui->actionSave, &QAction::triggered, this, [this]()
+        {
+            ui->statusbar->showMessage(tr("Сохранение..."));
+            auto checkpoint = journal->checkpoint();
+            auto written = database->writeTiles();
+
+            // editing goes on, the first input while the workers snapshot takes the rest of the tiles at once
+            qApp->installEventFilter(this);
+
+            written.then(this, [this, checkpoint](QStringList failed)
+            {
+                qApp->removeEventFilter(this);
+                if(failed.isEmpty())
+                {
+                    journal->truncate(checkpoint);
+                    ui->statusbar->showMessage(tr("Маршрут сохранен"), 3000);
+                }
+                else
+                    ui->statusbar->showMessage(tr("Ошибка записи: %1").arg(failed.join(", ")));
+            });
+        });
 
         connect(sorter, &TilesSorter::doubleClicked, manipulator.get(), &Manipulator::moveToObject);
 
@@ -293,11 +356,15 @@ QWindow* MainWindow::initilizeVSGwindow()
 
         connect(manipulator.get(), &Manipulator::sendIntersection, this, &MainWindow::intersection);
 
-        connect(manipulator.get(), &Manipulator::sendPos, [this](const vsg::dvec3 &pos)
+        sorter->setOrigin(centre);
+        connect(manipulator.get(), &Manipulator::sendPos, [this, ellipsoidModel](const vsg::dvec3 &pos)
         {
             ui->cursorLat->setValue(pos.x);
             ui->cursorLon->setValue(pos.y);
             ui->cursorAlt->setValue(pos.z);
+            // near: queries measure from the viewpoint
+            if(ellipsoidModel)
+                sorter->setOrigin(ellipsoidModel->convertLatLongAltitudeToECEF(pos));
         });
 
         connect(ui->cursorLat, &QDoubleSpinBox::valueChanged, [this, manipulator](double value)
@@ -320,6 +387,59 @@ QWindow* MainWindow::initilizeVSGwindow()
 
         database->setViewer(viewer);
 
+        // structural edits should leave these as they are, only new content is compiled
+        auto compileLabel = new QLabel(ui->statusbar);
+        ui->statusbar->addPermanentWidget(compileLabel);
+        connect(database->undoStack, &QUndoStack::indexChanged, compileLabel, [this, compileLabel]()
+        {
+            compileLabel->setText(tr("Компиляций: %1, данных: %2")
+                                  .arg(CompileStats::calls()).arg(locale().formattedDataSize(static_cast<qint64>(CompileStats::bytes()))));
+        });
+
+        if(database->tilesBudget != 0)
+        {
+            auto residentLabel = new QLabel(ui->statusbar);
+            ui->statusbar->addPermanentWidget(residentLabel);
+
+            auto evictTimer = new QTimer(this);
+            connect(evictTimer, &QTimer::timeout, this, [this, residentLabel]()
+            {
+                database->evictTiles();
+                residentLabel->setText(tr("Тайлы в памяти: %1 из %2")
+                                       .arg(locale().formattedDataSize(static_cast<qint64>(database->residentBytes())))
+                                       .arg(locale().formattedDataSize(static_cast<qint64>(database->tilesBudget))));
+            });
+            evictTimer->start(1000);
+        }
+
+        if(database->hasPendingTiles())
+        {
+            auto bar = new QProgressBar(ui->statusbar);
+            bar->setMaximumWidth(200);
+            ui->statusbar->addPermanentWidget(bar);
+
+            if(!computeBounds.bounds.valid())
+            {
+                auto first = std::make_shared<QMetaObject::Connection>();
+                *first = connect(database->tilesModel, &SceneModel::rowsInserted, this, [this, first, manipulator](const QModelIndex &parent, int row)
+                {
+                    disconnect(*first);
+                    manipulator->moveToObject(database->tilesModel->index(row, 0, parent));
+                });
+            }
+
+            database->loadTiles(bar).then(this, [this]()
+            {
+                showCacheStatistics();
+                restoreEdits();
+            });
+        }
+        else
+        {
+            showCacheStatistics();
+            restoreEdits();
+        }
+
         return true;
     };
 
@@ -377,16 +497,21 @@ void MainWindow::constructWidgets()
 
     sorter = new TilesSorter(this);
     //sorter->setSourceModel();
-    sorter->setFilterKeyColumn(1);
-    sorter->setFilterWildcard("*");
     ui->tilesView->setModel(sorter);
 
-    connect(ui->lineEdit, &QLineEdit::textChanged, sorter, &TilesSorter::setFilterWildcard);
+    connect(ui->lineEdit, &QLineEdit::textChanged, sorter, &TilesSorter::setFilterPattern);
+    connect(ui->lineEdit, &QLineEdit::returnPressed, sorter, &TilesSorter::selectFound);
     connect(ui->tilesView->selectionModel(), &QItemSelectionModel::selectionChanged, sorter, &TilesSorter::viewSelectSlot);
     connect(ui->tilesView, &QTreeView::doubleClicked, sorter, &TilesSorter::viewDoubleClicked);
     connect(sorter, &TilesSorter::viewSelectSignal, ui->tilesView->selectionModel(),
              qOverload<const QModelIndex &, QItemSelectionModel::SelectionFlags>(&QItemSelectionModel::select));
+    connect(sorter, &TilesSorter::viewSelectionSignal, ui->tilesView->selectionModel(),
+             qOverload<const QItemSelection &, QItemSelectionModel::SelectionFlags>(&QItemSelectionModel::select));
     connect(sorter, &TilesSorter::viewExpandSignal, ui->tilesView, &QTreeView::expand);
+    connect(ui->tilesView, &QTreeView::expanded, this, [this](const QModelIndex &index)
+    {
+        database->requestTile(sorter->mapToSource(index));
+    });
 
     ui->centralsplitter->addWidget(embedded);
     QList<int> sizes;
@@ -396,6 +521,9 @@ void MainWindow::constructWidgets()
 
 MainWindow::~MainWindow()
 {
+    // a save still being written must reach the disk, then the journal is only needed for unsaved edits
+    if(database->waitForSave() && database->undoStack->isClean())
+        journal->discard();
     delete ui;
 }
 
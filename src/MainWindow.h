@@ -15,6 +15,7 @@
 #include "ObjectPropertiesEditor.h"
 #include "RailsPointEditor.h"
 #include "AddRails.h"
+#include "EditJournal.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -25,12 +26,15 @@ class MainWindow : public QMainWindow
     Q_OBJECT
 
 public:
-    MainWindow(vsg::ref_ptr<DatabaseManager> dbm, QWidget *parent = nullptr);
+    MainWindow(vsg::ref_ptr<DatabaseManager> dbm, bool replayJournal = false, QWidget *parent = nullptr);
     ~MainWindow();
 
 public slots:
     void intersection(const FoundNodes& isection);
 
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
 private:
     QWindow* initilizeVSGwindow();
     QWidget *embedded;
@@ -39,6 +43,10 @@ private:
 
     void initializeTools();
 
+    void showCacheStatistics();
+
+    void restoreEdits();
+
     Ui::MainWindow *ui;
 
     ObjectPropertiesEditor *ope;
@@ -49,6 +57,9 @@ private:
     vsgQt::ViewerWindow *viewerWindow;
     DatabaseManager *database;
 
+    EditJournal *journal;
+    bool replayJournal;
+
     QString pathDB;
 
     TilesSorter *sorter;
@@ -82,8 +82,12 @@ void Manipulator::apply(vsg::ButtonPressEvent& buttonPress)
             _database->undoStack->endMacro();
             _isMoving = false;
         }
+        // picks go to the tools, which edit the scene a save may still be reading
         else
+        {
+            _database->finishSnapshots();
             emit sendIntersection(intersectedObjects(_mask, buttonPress));
+        }
     } else if (buttonPress.mask & vsg::BUTTON_MASK_2)
         _updateMode = ROTATE;
     else if (buttonPress.mask & vsg::BUTTON_MASK_3 && _ellipsoidModel)
@@ -227,9 +231,18 @@ void Manipulator::moveToObject(const QModelIndex &index)
         setViewpoint(sceneobject->getWorldPosition());
         return;
     }
-    ParentTracer pt;
-    object->accept(pt);
-    auto ltw = vsg::computeTransform(pt.nodePath);
+    if(auto indexed = object->cast<IndexedObject>(); indexed)
+    {
+        setViewpoint(indexed->position);
+        return;
+    }
+    if(TileLoader::isStub(object))
+    {
+        auto bounds = TileLoader::stubBounds(object);
+        setViewpoint((bounds.min + bounds.max) * 0.5);
+        return;
+    }
+    auto ltw = vsg::computeTransform(_database->tilesModel->nodePath(object));
 
     vsg::ComputeBounds computeBounds;
     object->accept(computeBounds);
@@ -243,6 +256,7 @@ void Manipulator::setFirst(vsg::ref_ptr<route::SceneObject> firstObject)
 }
 void Manipulator::startMoving()
 {
+    _database->finishSnapshots();
     if(!_isMoving)
     {
         _isMoving = true;
@@ -258,6 +272,7 @@ void Manipulator::apply(vsg::MoveEvent &pointerEvent)
 
     if(!_isMoving || !_movingObject)
         return;
+    _database->finishSnapshots();
 
 
         auto isections = intersections(route::Tiles, pointerEvent);
@@ -304,6 +319,17 @@ void Manipulator::apply(vsg::MoveEvent &pointerEvent)
 
 }
 
+void Manipulator::apply(vsg::FrameEvent &frame)
+{
+    Trackball::apply(frame);
+
+    // only look for nearby stubs once the camera has moved a noticeable part of the threshold
+    if(_database->lazyDistance <= 0.0 || vsg::length(_lookAt->eye - _lastRequestEye) < _database->lazyDistance * 0.25)
+        return;
+    _lastRequestEye = _lookAt->eye;
+    _database->requestTilesNear(_lookAt->eye);
+}
+
 FindNode Manipulator::intersectedObjects(vsg::LineSegmentIntersector::Intersections isections)
 {
     if(isections.empty())
@@ -322,7 +348,26 @@ vsg::LineSegmentIntersector::Intersections Manipulator::intersections(uint32_t m
 {
     auto intersector = vsg::LineSegmentIntersector::create(*_camera, pointerEvent.x, pointerEvent.y);
     intersector->traversalMask = mask;
-    _database->tilesModel->getRoot()->accept(*intersector);
+    _database->loadIntersectedTiles(*intersector);
+
+    // only the leaves whose bounds the ray passes are traversed, each under a stand-in for its parents
+    auto model = _database->tilesModel;
+    auto placed = vsg::MatrixTransform::create();
+    for (auto leaf : model->bounds().intersect(*intersector, mask))
+    {
+        auto path = model->nodePath(leaf);
+        placed->matrix = vsg::computeTransform(path);
+        placed->children = {vsg::ref_ptr<vsg::Node>(const_cast<vsg::Node*>(leaf))};
+        auto first = intersector->intersections.size();
+        placed->accept(*intersector);
+        for (auto i = first; i < intersector->intersections.size(); ++i)
+        {
+            auto &nodePath = intersector->intersections[i]->nodePath;
+            nodePath.erase(nodePath.begin());
+            nodePath.insert(nodePath.begin(), path.begin(), path.end());
+        }
+    }
+    placed->children.clear();
 
     if (intersector->intersections.empty()) return vsg::LineSegmentIntersector::Intersections();
 
@@ -23,6 +23,7 @@ public:
     void apply(vsg::KeyReleaseEvent& keyPress) override;
     void apply(vsg::ButtonPressEvent& buttonPressEvent) override;
     void apply(vsg::MoveEvent& pointerEvent) override;
+    void apply(vsg::FrameEvent& frame) override;
 
     void rotate(double angle, const vsg::dvec3& axis) override;
     void zoom(double ratio) override;
@@ -78,6 +79,8 @@ protected:
     uint16_t _keyModifier = 0x0;
 
     vsg::LineSegmentIntersector::Intersection _lastIntersection;
+
+    vsg::dvec3 _lastRequestEye = {};
 };
 /*
 template<class T>
@@ -0,0 +1,62 @@
+#ifndef MEMORYSTREAM_H
+#define MEMORYSTREAM_H
+
+#include <istream>
+#include <streambuf>
+
+// Read-only stream over memory owned by someone else, so mapped files and mime data
+// can be parsed in place instead of being copied into a stream buffer first.
+// What is parsed out of it is still copied, nothing keeps pointing into the memory.
+class MemoryStreamBuf : public std::streambuf
+{
+public:
+    MemoryStreamBuf(const char *data, std::size_t size)
+    {
+        auto begin = const_cast<char*>(data);
+        setg(begin, begin, begin + size);
+    }
+
+protected:
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override
+    {
+        if((which & std::ios_base::in) == 0)
+            return pos_type(off_type(-1));
+
+        char *pos = nullptr;
+        switch (dir) {
+        case std::ios_base::beg:
+            pos = eback() + off;
+            break;
+        case std::ios_base::cur:
+            pos = gptr() + off;
+            break;
+        default:
+            pos = egptr() + off;
+            break;
+        }
+        if(pos < eback() || pos > egptr())
+            return pos_type(off_type(-1));
+        setg(eback(), pos, egptr());
+        return pos_type(pos - eback());
+    }
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override
+    {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+};
+
+class MemoryStream : public std::istream
+{
+public:
+    MemoryStream(const char *data, std::size_t size)
+        : std::istream(nullptr)
+        , _buf(data, size)
+    {
+        rdbuf(&_buf);
+    }
+
+private:
+    MemoryStreamBuf _buf;
+};
+
+#endif // MEMORYSTREAM_H
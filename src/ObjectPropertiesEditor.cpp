@@ -142,14 +142,13 @@ ObjectPropertiesEditor::ObjectPropertiesEditor(DatabaseManager *database, QWidge
 
     connect(ui->trjCoordspin, &QDoubleSpinBox::valueChanged, this, [stack, this](double d)
     {
-        vsg::MatrixTransform *mt = nullptr;
-        if(_firstObject->getValue(app::PARENT, mt))
-            stack->push(new MoveObjectOnTraj(mt, d));
+        if(auto mt = trajectoryTransform(); mt)
+            stack->push(new MoveObjectOnTraj(_database->tilesModel, mt, d));
     });
 
     connect(ui->nameEdit, &QLineEdit::textEdited, this, [stack, this](const QString &text)
     {
-        stack->push(new RenameObject(_firstObject.get(), text));
+        stack->push(new RenameObject(_database->tilesModel, _firstObject.get(), text));
     });
 
     connect(ui->stationBox, &QComboBox::currentIndexChanged, this, [this](int idx)
@@ -161,11 +160,13 @@ ObjectPropertiesEditor::ObjectPropertiesEditor(DatabaseManager *database, QWidge
         if(idx == -1)
         {
             sig->station.clear();
+            _database->markDirty(sig, true);
             return;
         }
         _idx = std::next(_database->topology->stations.begin(), idx);
         _idx->second->rsignals.insert({sig, signalling::Routes::create()});
         sig->station = _idx->first;
+        _database->markDirty(sig, true);
 
     });
 }
@@ -247,6 +248,7 @@ void ObjectPropertiesEditor::selectObject(route::SceneObject *object)
 
 void ObjectPropertiesEditor::toggle(route::SceneObject *object)
 {
+    _database->tilesModel->fetchTo(object);
     auto index = _database->tilesModel->index(object);
     if(auto selectedIt = _selectedObjects.find(index); selectedIt != _selectedObjects.end())
     {
@@ -303,6 +305,18 @@ void ObjectPropertiesEditor::setSpinEanbled(bool enabled)
     ui->trjCoordspin->setEnabled(enabled);
 }
 
+vsg::MatrixTransform *ObjectPropertiesEditor::trajectoryTransform() const
+{
+    // objects placed on a track sit in a transform right under the trajectory
+    auto model = _database->tilesModel;
+    auto parent = model->parentNode(_firstObject);
+    auto transform = parent ? parent->cast<vsg::MatrixTransform>() : nullptr;
+    if(!transform)
+        return nullptr;
+    auto trajectory = model->parentNode(transform);
+    return trajectory && trajectory->is_compatible(typeid (route::Trajectory)) ? transform : nullptr;
+}
+
 void ObjectPropertiesEditor::updateData()
 {
     QSignalBlocker l1(ui->ecefXspin);
@@ -339,8 +353,7 @@ void ObjectPropertiesEditor::updateData()
     else
         ui->stationBox->setEnabled(false);
 
-    vsg::MatrixTransform *rmt = nullptr;
-    if(_firstObject->getValue(app::PARENT, rmt))
+    if(auto rmt = trajectoryTransform(); rmt)
     {
         double val = 0.0;
         rmt->getValue(app::PROP, val);
@@ -41,6 +41,7 @@ private:
     void toggle(route::SceneObject* object);
     void select(const QModelIndex &index, route::SceneObject *object);
     void setSpinEanbled(bool enabled);
+    vsg::MatrixTransform *trajectoryTransform() const;
 
     Ui::ObjectPropertiesEditor *ui;
 
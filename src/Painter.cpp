@@ -1,5 +1,6 @@
 #include "Painter.h"
 #include "ui_Painter.h"
+#include "TextureCompressor.h"
 #include <vsg/traversals/ComputeBounds.h>
 #include <vsg/nodes/StateGroup.h>
 #include <vsg/nodes/CullNode.h>
@@ -44,9 +45,12 @@ void Painter::intersection(const FoundNodes &isection)
     if(!fdi.imageInfo || !fdi.terrainInfo)
         return;
 
+    // compressed layers are painted on their source and re-encoded where touched
+    auto view = TextureCompressor::sourceView(fdi.imageInfo);
+
     QImage::Format format;
 
-    switch (fdi.imageInfo->imageView->format) {
+    switch (view->format) {
     case VK_FORMAT_R8G8B8A8_UNORM:
         format = QImage::Format_RGBA8888;
         break;
@@ -54,7 +58,7 @@ void Painter::intersection(const FoundNodes &isection)
         return;
     }
 
-    auto data = fdi.imageInfo->imageView->image->data;
+    auto data = view->image->data;
     auto tdata = fdi.terrainInfo->imageView->image->data;
     auto qimage = new QImage(static_cast<uchar*>(data->dataPointer()), data->width(), data->height(), format);
 
@@ -89,9 +93,11 @@ void Painter::intersection(const FoundNodes &isection)
 
     p.setCompositionMode(QPainter::CompositionMode_DestinationOver);
     p.drawImage(rect, _image);
+    p.end();
 
-
-     _database->copyImageCmd->copy(data, fdi.imageInfo);
+    TextureCompressor::update(fdi.imageInfo, rect);
+    _database->markDirty(isection.terrain);
+    _database->copyImageCmd->copy(fdi.imageInfo->imageView->image->data, fdi.imageInfo);
 }
 
 void Painter::activeTextureChanged(const QItemSelection &selected, const QItemSelection &)
@@ -45,7 +45,7 @@ RailsPointEditor::RailsPointEditor(DatabaseManager *database, QWidget *parent) :
         {
             vsg::ref_ptr<route::RailPoint> ref(object);
             auto fn = [ref](double val){ ref->setTangent(val); };
-            new ExecuteLambda<decltype (fn), double>(fn, ref->_tangent, d, 6, parent);
+            new ExecuteLambda<decltype (fn), double>(fn, ref->_tangent, d, 6, ref, parent);
         }
 
         stack->push(parent);
@@ -58,7 +58,7 @@ RailsPointEditor::RailsPointEditor(DatabaseManager *database, QWidget *parent) :
         {
             vsg::ref_ptr<route::RailPoint> ref(object);
             auto fn = [ref](double val){ ref->setTilt(val); };
-            new ExecuteLambda<decltype (fn), double>(fn, ref->_tilt, d, 7, parent);
+            new ExecuteLambda<decltype (fn), double>(fn, ref->_tilt, d, 7, ref, parent);
         }
 
         stack->push(parent);
@@ -72,7 +72,7 @@ RailsPointEditor::RailsPointEditor(DatabaseManager *database, QWidget *parent) :
         {
             vsg::ref_ptr<route::RailPoint> ref(object);
             auto fn = [ref](double val){ ref->setCHeight(val); };
-            new ExecuteLambda<decltype (fn), double>(fn, ref->_cheight, d, 8, parent);
+            new ExecuteLambda<decltype (fn), double>(fn, ref->_cheight, d, 8, ref, parent);
         }
 
         stack->push(parent);
@@ -0,0 +1,298 @@
+#include "RouteIndex.h"
+#include "TileLoader.h"
+#include "Constants.h"
+#include "sceneobjects.h"
+#include <QDataStream>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+
+namespace {
+    constexpr quint32 MAGIC = 0x52494458; // "RIDX"
+    constexpr quint32 VERSION = 1;
+
+    void writeVec(QDataStream &stream, const vsg::dvec3 &vec)
+    {
+        stream << vec.x << vec.y << vec.z;
+    }
+    void readVec(QDataStream &stream, vsg::dvec3 &vec)
+    {
+        stream >> vec.x >> vec.y >> vec.z;
+    }
+
+    void collect(vsg::Node *node, qint32 parent, std::vector<RouteIndex::Entry> &entries)
+    {
+        RouteIndex::Entry entry;
+        entry.parent = parent;
+        entry.className = node->className();
+        std::string name;
+        if(node->getValue(app::NAME, name))
+            entry.name = QString::fromStdString(name);
+
+        auto row = static_cast<qint32>(entries.size());
+        entries.push_back(entry);
+
+        // objects are leaves of the index, their own children are geometry
+        if(auto object = node->cast<route::SceneObject>(); object)
+        {
+            entries[row].position = object->getWorldPosition();
+            return;
+        }
+
+        auto first = entries.size();
+        if(auto sw = node->cast<vsg::Switch>(); sw)
+        {
+            for (auto &child : sw->children)
+                if((child.mask & route::SceneObjects) != 0)
+                    collect(child.node, row, entries);
+        }
+        else if(auto group = node->cast<vsg::Group>(); group)
+        {
+            for (auto &child : group->children)
+                collect(child, row, entries);
+        }
+
+        // groups are placed at the centre of what they hold
+        vsg::dvec3 centre;
+        int count = 0;
+        for (auto i = first; i < entries.size(); ++i)
+        {
+            if(entries[i].parent == row)
+            {
+                centre += entries[i].position;
+                count++;
+            }
+        }
+        if(count != 0)
+            entries[row].position = centre / static_cast<double>(count);
+    }
+}
+
+RouteIndex::RouteIndex(const QDir &routeDir)
+    : _dir(routeDir)
+{
+}
+RouteIndex::~RouteIndex()
+{
+}
+
+vsg::ref_ptr<RouteIndex> RouteIndex::read(const QDir &routeDir)
+{
+    QFile file(routeDir.filePath(FILE_NAME));
+    if(!file.open(QIODevice::ReadOnly))
+        return {};
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0, version = 0, count = 0;
+    in >> magic >> version >> count;
+    if(magic != MAGIC || version != VERSION)
+        return {};
+
+    auto index = RouteIndex::create(routeDir);
+    index->_tiles.reserve(count);
+    for (quint32 i = 0; i < count; ++i)
+    {
+        Tile tile;
+        in >> tile.file >> tile.name >> tile.modified >> tile.size;
+        readVec(in, tile.bounds.min);
+        readVec(in, tile.bounds.max);
+        in >> tile.objects >> tile.offset >> tile.count;
+        index->_byFile.insert(tile.file, index->_tiles.size());
+        index->_tiles.push_back(tile);
+    }
+    if(in.status() != QDataStream::Ok)
+        return {};
+
+    index->_dataStart = file.pos();
+    index->_fileModified = QFileInfo(file).lastModified().toMSecsSinceEpoch();
+    return index;
+}
+
+bool RouteIndex::write() const
+{
+    // entries go after the tile table, each tile keeps the offset of its block
+    QByteArray data;
+    QDataStream entriesOut(&data, QIODevice::WriteOnly);
+    entriesOut.setVersion(QDataStream::Qt_6_0);
+
+    std::vector<qint64> offsets;
+    for (const auto &tile : _tiles)
+    {
+        offsets.push_back(data.size());
+        for (const auto &entry : tile.entries)
+        {
+            entriesOut << entry.parent << entry.className << entry.name;
+            writeVec(entriesOut, entry.position);
+        }
+    }
+
+    QFile file(path() + ".part");
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << MAGIC << VERSION << static_cast<quint32>(_tiles.size());
+    for (std::size_t i = 0; i < _tiles.size(); ++i)
+    {
+        const auto &tile = _tiles[i];
+        out << tile.file << tile.name << tile.modified << tile.size;
+        writeVec(out, tile.bounds.min);
+        writeVec(out, tile.bounds.max);
+        out << tile.objects << offsets[i] << static_cast<quint32>(tile.entries.size());
+    }
+    out.writeRawData(data.constData(), data.size());
+    file.close();
+
+    if(out.status() != QDataStream::Ok)
+    {
+        QFile::remove(file.fileName());
+        return false;
+    }
+    QFile::remove(path());
+    return QFile::rename(file.fileName(), path());
+}
+
+void RouteIndex::addTile(const QString &path, vsg::Node *node)
+{
+    QFileInfo fi(path);
+
+    Tile tile;
+    tile.file = fi.fileName();
+    tile.modified = fi.lastModified().toMSecsSinceEpoch();
+    tile.size = fi.size();
+
+    std::string name;
+    tile.name = node->getValue(app::NAME, name) ? QString::fromStdString(name) : fi.completeBaseName();
+
+    // a tile that was never loaded only contributes what its stub knows
+    if(TileLoader::isStub(node))
+    {
+        tile.bounds = TileLoader::stubBounds(node);
+        tile.objects = static_cast<quint32>(TileLoader::stubObjects(node));
+        addTile(tile);
+        return;
+    }
+
+    auto stub = TileLoader::createStub(node);
+    tile.bounds = TileLoader::stubBounds(stub);
+    tile.objects = static_cast<quint32>(TileLoader::stubObjects(stub));
+
+    if(auto sw = node->cast<vsg::Switch>(); sw)
+    {
+        for (auto &child : sw->children)
+            if((child.mask & route::SceneObjects) != 0)
+                collect(child.node, -1, tile.entries);
+    }
+    tile.count = static_cast<quint32>(tile.entries.size());
+
+    addTile(tile);
+}
+
+void RouteIndex::addTile(Tile tile)
+{
+    if(auto it = _byFile.find(tile.file); it != _byFile.end())
+        _tiles[*it] = std::move(tile);
+    else
+    {
+        _byFile.insert(tile.file, _tiles.size());
+        _tiles.push_back(std::move(tile));
+    }
+}
+
+void RouteIndex::refresh(const QString &path)
+{
+    QFileInfo fi(path);
+    if(auto it = _byFile.find(fi.fileName()); it != _byFile.end())
+    {
+        _tiles[*it].modified = fi.lastModified().toMSecsSinceEpoch();
+        _tiles[*it].size = fi.size();
+    }
+}
+
+const RouteIndex::Tile *RouteIndex::find(const QString &path) const
+{
+    QFileInfo fi(path);
+    auto it = _byFile.find(fi.fileName());
+    if(it == _byFile.end())
+        return nullptr;
+
+    // a tile changed on disk since the index was written is not trusted
+    const auto &tile = _tiles[*it];
+    if(tile.modified != fi.lastModified().toMSecsSinceEpoch() || tile.size != fi.size())
+        return nullptr;
+    return &tile;
+}
+
+std::vector<RouteIndex::Entry> RouteIndex::entries(const Tile &tile) const
+{
+    if(!tile.entries.empty() || tile.count == 0)
+        return tile.entries;
+
+    // offsets are only valid in the file this index was read from, a save may have replaced it
+    QFile file(path());
+    if(QFileInfo(file).lastModified().toMSecsSinceEpoch() != _fileModified)
+        return {};
+    if(!file.open(QIODevice::ReadOnly) || !file.seek(_dataStart + tile.offset))
+        return {};
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    std::vector<Entry> entries(tile.count);
+    for (auto &entry : entries)
+    {
+        in >> entry.parent >> entry.className >> entry.name;
+        readVec(in, entry.position);
+    }
+    if(in.status() != QDataStream::Ok)
+        return {};
+    return entries;
+}
+
+vsg::ref_ptr<vsg::Switch> RouteIndex::createStub(const QString &path) const
+{
+    auto tile = find(path);
+    if(!tile)
+        return {};
+
+    auto stub = vsg::Switch::create();
+    stub->setValue(app::PATH, path.toStdString());
+    stub->setValue(app::NAME, tile->name.toStdString());
+    stub->setValue(TileLoader::BOUND_MIN, tile->bounds.min);
+    stub->setValue(TileLoader::BOUND_MAX, tile->bounds.max);
+    stub->setValue(TileLoader::OBJECTS, static_cast<int>(tile->objects));
+    stub->setValue(TileLoader::STUB, true);
+
+    stub->children = placeholders(path);
+    return stub;
+}
+
+vsg::Switch::Children RouteIndex::placeholders(const QString &path) const
+{
+    vsg::Switch::Children children;
+
+    auto tile = find(path);
+    if(!tile)
+        return children;
+
+    auto indexed = entries(*tile);
+    std::vector<vsg::ref_ptr<IndexedObject>> nodes;
+    nodes.reserve(indexed.size());
+    for (const auto &entry : indexed)
+    {
+        auto node = IndexedObject::create();
+        node->objectClass = entry.className.toStdString();
+        node->position = entry.position;
+        node->setValue(app::NAME, entry.name.toStdString());
+
+        if(entry.parent < 0 || entry.parent >= static_cast<qint32>(nodes.size()))
+            children.push_back(vsg::Switch::Child{route::SceneObjects, node});
+        else
+            nodes[entry.parent]->addChild(node);
+        nodes.push_back(node);
+    }
+    return children;
+}
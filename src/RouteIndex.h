@@ -0,0 +1,78 @@
+#ifndef ROUTEINDEX_H
+#define ROUTEINDEX_H
+
+#include <QString>
+#include <QDir>
+#include <QHash>
+#include <vsg/nodes/Switch.h>
+#include <vsg/maths/box.h>
+
+// stands in for an indexed object in the tree until its tile is loaded
+class IndexedObject : public vsg::Inherit<vsg::Group, IndexedObject>
+{
+public:
+    IndexedObject() : vsg::Inherit<vsg::Group, IndexedObject>() {}
+
+    std::string objectClass;
+    vsg::dvec3 position;
+
+protected:
+    virtual ~IndexedObject() {}
+};
+
+class RouteIndex : public vsg::Inherit<vsg::Object, RouteIndex>
+{
+public:
+    struct Entry
+    {
+        qint32 parent = -1;
+        QString className;
+        QString name;
+        vsg::dvec3 position;
+    };
+
+    struct Tile
+    {
+        QString file;
+        QString name;
+        qint64 modified = 0;
+        qint64 size = 0;
+        vsg::dbox bounds;
+        quint32 objects = 0;
+        qint64 offset = 0;
+        quint32 count = 0;
+        std::vector<Entry> entries;
+    };
+
+    RouteIndex(const QDir &routeDir);
+    virtual ~RouteIndex();
+
+    static vsg::ref_ptr<RouteIndex> read(const QDir &routeDir);
+    bool write() const;
+
+    void addTile(const QString &path, vsg::Node *node);
+    void addTile(Tile tile);
+    // takes the time and size of a tile file that was written after it was added
+    void refresh(const QString &path);
+
+    QString path() const { return _dir.filePath(FILE_NAME); }
+
+    const Tile *find(const QString &path) const;
+    const std::vector<Tile> &tiles() const { return _tiles; }
+    std::vector<Entry> entries(const Tile &tile) const;
+
+    vsg::ref_ptr<vsg::Switch> createStub(const QString &path) const;
+    vsg::Switch::Children placeholders(const QString &path) const;
+
+    static constexpr const char* FILE_NAME = "route.idx";
+
+private:
+    QDir _dir;
+    std::vector<Tile> _tiles;
+    QHash<QString, std::size_t> _byFile;
+
+    qint64 _dataStart = 0;
+    qint64 _fileModified = 0;
+};
+
+#endif // ROUTEINDEX_H
@@ -0,0 +1,23 @@
+#ifndef ROUTETYPES_H
+#define ROUTETYPES_H
+
+#include <vsg/nodes/Group.h>
+#include <vsg/io/Input.h>
+#include <vsg/io/Output.h>
+
+class PointsGroup : public vsg::Inherit<vsg::Group, PointsGroup>
+{
+public:
+    PointsGroup() : vsg::Inherit<vsg::Group, PointsGroup>() {}
+
+    void read(vsg::Input& input) override { vsg::Node::read(input); }
+    void write(vsg::Output& output) const override { vsg::Node::write(output); }
+
+protected:
+    virtual ~PointsGroup(){}
+};
+
+// registers every route, signalling and editor class with the vsg object factory
+void registerRouteTypes();
+
+#endif // ROUTETYPES_H
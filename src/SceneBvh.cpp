@@ -0,0 +1,409 @@
+#include "SceneBvh.h"
+#include "sceneobjects.h"
+#include "trajectory.h"
+#include <vsg/nodes/Switch.h>
+#include <vsg/nodes/StateGroup.h>
+#include <vsg/traversals/ComputeBounds.h>
+#include <algorithm>
+
+namespace {
+    bool pickable(const vsg::Node &node)
+    {
+        return node.is_compatible(typeid (route::SceneObject)) || node.is_compatible(typeid (route::Trajectory))
+                || node.is_compatible(typeid (route::RailConnector));
+    }
+
+    // finds the leaves below a node: what can be picked as a whole, geometry under its state
+    // and anything that is not a group; groups, switches and plain transforms are descended
+    class Leaves : public vsg::Visitor
+    {
+    public:
+        Leaves(const vsg::dmat4 &ltw, uint64_t mask)
+        {
+            stack.push_back({ltw, mask});
+        }
+
+        void apply(vsg::Node &node) override
+        {
+            found.push_back({&node, stack.back().first, stack.back().second});
+        }
+        void apply(vsg::StateGroup &group) override
+        {
+            apply(static_cast<vsg::Node&>(group));
+        }
+        void apply(vsg::Group &group) override
+        {
+            if(pickable(group))
+                return apply(static_cast<vsg::Node&>(group));
+            group.traverse(*this);
+        }
+        void apply(vsg::Switch &sw) override
+        {
+            if(pickable(sw))
+                return apply(static_cast<vsg::Node&>(sw));
+            for (auto &child : sw.children)
+            {
+                if(!child.node)
+                    continue;
+                stack.push_back({stack.back().first, child.mask});
+                child.node->accept(*this);
+                stack.pop_back();
+            }
+        }
+        void apply(vsg::Transform &transform) override
+        {
+            if(pickable(transform))
+                return apply(static_cast<vsg::Node&>(transform));
+            stack.push_back({transform.transform(stack.back().first), stack.back().second});
+            transform.traverse(*this);
+            stack.pop_back();
+        }
+
+        struct Leaf
+        {
+            vsg::Node *node;
+            vsg::dmat4 ltw;
+            uint64_t mask;
+        };
+        std::vector<Leaf> found;
+
+    private:
+        std::vector<std::pair<vsg::dmat4, uint64_t>> stack;
+    };
+}
+
+SceneBvh::SceneBvh()
+    : _placed(vsg::MatrixTransform::create())
+{
+}
+
+void SceneBvh::add(vsg::Node *node, const vsg::dmat4 &ltw, uint64_t mask)
+{
+    Leaves leaves(ltw, mask);
+    node->accept(leaves);
+    for (const auto &leaf : leaves.found)
+    {
+        remove(leaf.node);
+        insert(leaf.node, measure(leaf.node, leaf.ltw), leaf.mask);
+    }
+}
+
+void SceneBvh::remove(const vsg::Node *node)
+{
+    if(auto leaf = _leaves.find(node); leaf != _leaves.end())
+    {
+        erase(leaf.value());
+        _leaves.erase(leaf);
+        return;
+    }
+    if(_unbounded.remove(node))
+        return;
+
+    // a group is not a leaf itself, its leaves are found the way they were added
+    Leaves leaves(vsg::dmat4(), ALL);
+    const_cast<vsg::Node*>(node)->accept(leaves);
+    for (const auto &leaf : leaves.found)
+    {
+        if(leaf.node == node)
+            continue;
+        if(auto found = _leaves.find(leaf.node); found != _leaves.end())
+        {
+            erase(found.value());
+            _leaves.erase(found);
+        }
+        else
+            _unbounded.remove(leaf.node);
+    }
+}
+
+void SceneBvh::update(const vsg::Node *leaf, const vsg::dmat4 &ltw)
+{
+    uint64_t mask = 0;
+    if(auto found = _leaves.find(leaf); found != _leaves.end())
+    {
+        mask = _items[found.value()].mask;
+        erase(found.value());
+        _leaves.erase(found);
+    }
+    else if(auto unbounded = _unbounded.find(leaf); unbounded != _unbounded.end())
+    {
+        mask = unbounded.value();
+        _unbounded.erase(unbounded);
+    }
+    else
+        return;
+    insert(leaf, measure(leaf, ltw), mask);
+}
+
+std::vector<const vsg::Node*> SceneBvh::intersect(vsg::Intersector &intersector, uint64_t mask) const
+{
+    std::vector<const vsg::Node*> leaves;
+    for (auto it = _unbounded.cbegin(); it != _unbounded.cend(); ++it)
+        if((it.value() & mask) != 0)
+            leaves.push_back(it.key());
+
+    if(_root < 0)
+        return leaves;
+
+    std::vector<int> stack{_root};
+    while (!stack.empty())
+    {
+        const auto &item = _items[stack.back()];
+        stack.pop_back();
+        if((item.mask & mask) == 0)
+            continue;
+        auto centre = (item.bounds.min + item.bounds.max) * 0.5;
+        if(!intersector.intersects(vsg::dsphere(centre, vsg::length(item.bounds.max - item.bounds.min) * 0.5)))
+            continue;
+        if(item.leaf())
+            leaves.push_back(item.node);
+        else
+        {
+            stack.push_back(item.left);
+            stack.push_back(item.right);
+        }
+    }
+    return leaves;
+}
+
+bool SceneBvh::consistent() const
+{
+    std::vector<bool> reached(_items.size(), false);
+    std::size_t leaves = 0;
+    if(_root >= 0)
+    {
+        if(_items[_root].parent != -1)
+            return false;
+        std::vector<int> stack{_root};
+        while (!stack.empty())
+        {
+            auto index = stack.back();
+            stack.pop_back();
+            if(index < 0 || index >= static_cast<int>(_items.size()) || reached[index])
+                return false;
+            reached[index] = true;
+
+            const auto &item = _items[index];
+            if(item.leaf())
+            {
+                if(item.right >= 0 || item.height != 0 || _leaves.value(item.node, -1) != index)
+                    return false;
+                leaves++;
+                continue;
+            }
+            if(item.right < 0 || item.node)
+                return false;
+            const auto &left = _items[item.left];
+            const auto &right = _items[item.right];
+            if(left.parent != index || right.parent != index)
+                return false;
+            auto bounds = merge(left.bounds, right.bounds);
+            if(item.height != 1 + std::max(left.height, right.height) || item.mask != (left.mask | right.mask)
+                    || item.bounds.min != bounds.min || item.bounds.max != bounds.max)
+                return false;
+            stack.push_back(item.left);
+            stack.push_back(item.right);
+        }
+    }
+    if(leaves != static_cast<std::size_t>(_leaves.size()))
+        return false;
+
+    // what is not in the tree is on the free list, once
+    for (auto item : _free)
+    {
+        if(item < 0 || item >= static_cast<int>(_items.size()) || reached[item] || _items[item].node)
+            return false;
+        reached[item] = true;
+    }
+    return std::find(reached.begin(), reached.end(), false) == reached.end();
+}
+
+void SceneBvh::insert(const vsg::Node *node, const vsg::dbox &bounds, uint64_t mask)
+{
+    // nothing to measure, such a leaf is tried on every ray
+    if(!bounds.valid())
+    {
+        _unbounded.insert(node, mask);
+        return;
+    }
+
+    auto leaf = allocate();
+    _items[leaf].bounds = bounds;
+    _items[leaf].mask = mask;
+    _items[leaf].node = node;
+    _leaves.insert(node, leaf);
+
+    if(_root < 0)
+    {
+        _root = leaf;
+        return;
+    }
+
+    // the sibling is found by going down the side whose box grows least, as in Box2D's dynamic tree
+    auto index = _root;
+    while (!_items[index].leaf())
+    {
+        const auto &item = _items[index];
+        auto combined = area(merge(item.bounds, bounds));
+        auto cost = 2.0 * combined;
+        auto inheritance = 2.0 * (combined - area(item.bounds));
+        auto descend = [this, &bounds, inheritance](int child)
+        {
+            const auto &box = _items[child].bounds;
+            auto grown = area(merge(box, bounds));
+            return (_items[child].leaf() ? grown : grown - area(box)) + inheritance;
+        };
+        auto left = descend(item.left);
+        auto right = descend(item.right);
+        if(cost < left && cost < right)
+            break;
+        index = left < right ? item.left : item.right;
+    }
+
+    auto sibling = index;
+    auto oldParent = _items[sibling].parent;
+    auto newParent = allocate();
+    _items[newParent].parent = oldParent;
+    _items[newParent].left = sibling;
+    _items[newParent].right = leaf;
+    _items[sibling].parent = newParent;
+    _items[leaf].parent = newParent;
+    if(oldParent < 0)
+        _root = newParent;
+    else if(_items[oldParent].left == sibling)
+        _items[oldParent].left = newParent;
+    else
+        _items[oldParent].right = newParent;
+
+    refit(newParent);
+}
+
+void SceneBvh::erase(int leaf)
+{
+    if(leaf == _root)
+    {
+        _root = -1;
+        release(leaf);
+        return;
+    }
+
+    auto parent = _items[leaf].parent;
+    auto grandParent = _items[parent].parent;
+    auto sibling = _items[parent].left == leaf ? _items[parent].right : _items[parent].left;
+    release(leaf);
+    release(parent);
+
+    _items[sibling].parent = grandParent;
+    if(grandParent < 0)
+    {
+        _root = sibling;
+        return;
+    }
+    if(_items[grandParent].left == parent)
+        _items[grandParent].left = sibling;
+    else
+        _items[grandParent].right = sibling;
+    refit(grandParent);
+}
+
+int SceneBvh::allocate()
+{
+    if(_free.empty())
+    {
+        _items.emplace_back();
+        return static_cast<int>(_items.size() - 1);
+    }
+    auto item = _free.back();
+    _free.pop_back();
+    _items[item] = Item();
+    return item;
+}
+
+void SceneBvh::release(int item)
+{
+    _items[item].node = nullptr;
+    _free.push_back(item);
+}
+
+void SceneBvh::fit(int item)
+{
+    auto &parent = _items[item];
+    const auto &left = _items[parent.left];
+    const auto &right = _items[parent.right];
+    parent.bounds = merge(left.bounds, right.bounds);
+    parent.mask = left.mask | right.mask;
+    parent.height = 1 + std::max(left.height, right.height);
+}
+
+void SceneBvh::refit(int item)
+{
+    // boxes up to the root grow or shrink with the change, rotations keep the tree shallow
+    for (; item >= 0; item = _items[item].parent)
+    {
+        item = balance(item);
+        fit(item);
+    }
+}
+
+int SceneBvh::balance(int a)
+{
+    if(_items[a].leaf() || _items[a].height < 2)
+        return a;
+
+    auto b = _items[a].left;
+    auto c = _items[a].right;
+    auto difference = _items[c].height - _items[b].height;
+    if(difference >= -1 && difference <= 1)
+        return a;
+
+    // the taller child takes the place of a, a keeps the lower of the grandchildren
+    auto up = difference > 1 ? c : b;
+    auto first = _items[up].left;
+    auto second = _items[up].right;
+
+    _items[up].left = a;
+    _items[up].parent = _items[a].parent;
+    _items[a].parent = up;
+    if(auto parent = _items[up].parent; parent < 0)
+        _root = up;
+    else if(_items[parent].left == a)
+        _items[parent].left = up;
+    else
+        _items[parent].right = up;
+
+    auto keep = _items[first].height > _items[second].height ? first : second;
+    auto give = keep == first ? second : first;
+    _items[up].right = keep;
+    if(up == c)
+        _items[a].right = give;
+    else
+        _items[a].left = give;
+    _items[give].parent = a;
+
+    fit(a);
+    fit(up);
+    return up;
+}
+
+vsg::dbox SceneBvh::measure(const vsg::Node *node, const vsg::dmat4 &ltw)
+{
+    _placed->matrix = ltw;
+    _placed->children = {vsg::ref_ptr<vsg::Node>(const_cast<vsg::Node*>(node))};
+    vsg::ComputeBounds computeBounds;
+    _placed->accept(computeBounds);
+    _placed->children.clear();
+    return computeBounds.bounds;
+}
+
+double SceneBvh::area(const vsg::dbox &bounds)
+{
+    auto size = bounds.max - bounds.min;
+    return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+vsg::dbox SceneBvh::merge(const vsg::dbox &lhs, const vsg::dbox &rhs)
+{
+    auto bounds = lhs;
+    bounds.add(rhs);
+    return bounds;
+}
@@ -0,0 +1,73 @@
+#ifndef SCENEBVH_H
+#define SCENEBVH_H
+
+#include <QHash>
+#include <vsg/nodes/Node.h>
+#include <vsg/nodes/MatrixTransform.h>
+#include <vsg/maths/box.h>
+#include <vsg/maths/mat4.h>
+#include <vsg/traversals/Intersector.h>
+#include <vector>
+
+// world bounds of what can be picked in the scene: terrain of tiles, scene objects, trajectories and connectors,
+// kept in a tree of boxes that is updated in place as nodes are added, moved and removed
+class SceneBvh
+{
+public:
+    static constexpr uint64_t ALL = ~uint64_t(0);
+
+    SceneBvh();
+
+    // the leaves under the node, or the node itself, placed by the transform of its parents;
+    // mask is that of the switch child the node is reached through
+    void add(vsg::Node *node, const vsg::dmat4 &ltw, uint64_t mask);
+    // drops the leaves under the node, or the node itself
+    void remove(const vsg::Node *node);
+    // measures a leaf again after it moved
+    void update(const vsg::Node *leaf, const vsg::dmat4 &ltw);
+    bool contains(const vsg::Node *node) const { return _leaves.contains(node) || _unbounded.contains(node); }
+
+    // leaves the intersector may hit and whose mask it traverses, leaves without bounds are always among them
+    std::vector<const vsg::Node*> intersect(vsg::Intersector &intersector, uint64_t mask) const;
+
+    std::size_t size() const { return static_cast<std::size_t>(_leaves.size() + _unbounded.size()); }
+    // whether links, heights, masks and boxes agree and every item is either in the tree or free, for the tests
+    bool consistent() const;
+
+private:
+    struct Item
+    {
+        vsg::dbox bounds;
+        // of every leaf below
+        uint64_t mask = 0;
+        int parent = -1;
+        int left = -1;
+        int right = -1;
+        int height = 0;
+        const vsg::Node *node = nullptr;
+
+        bool leaf() const { return left < 0; }
+    };
+
+    void insert(const vsg::Node *node, const vsg::dbox &bounds, uint64_t mask);
+    void erase(int item);
+    int allocate();
+    void release(int item);
+    void fit(int item);
+    int balance(int item);
+    void refit(int item);
+    vsg::dbox measure(const vsg::Node *node, const vsg::dmat4 &ltw);
+
+    static double area(const vsg::dbox &bounds);
+    static vsg::dbox merge(const vsg::dbox &lhs, const vsg::dbox &rhs);
+
+    std::vector<Item> _items;
+    std::vector<int> _free;
+    int _root = -1;
+    QHash<const vsg::Node*, int> _leaves;
+    QHash<const vsg::Node*, uint64_t> _unbounded;
+    // stands in for the parents of a leaf while it is measured
+    vsg::ref_ptr<vsg::MatrixTransform> _placed;
+};
+
+#endif // SCENEBVH_H
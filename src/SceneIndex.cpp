@@ -0,0 +1,355 @@
+#include "SceneIndex.h"
+#include "RouteIndex.h"
+#include "sceneobjects.h"
+#include "signals.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+    constexpr qint64 CELL_OFFSET = 1 << 20;
+    constexpr quint64 CELL_MASK = (1 << 21) - 1;
+
+    quint64 cellKey(qint64 x, qint64 y, qint64 z)
+    {
+        return (quint64(x + CELL_OFFSET) & CELL_MASK) << 42 | (quint64(y + CELL_OFFSET) & CELL_MASK) << 21 | (quint64(z + CELL_OFFSET) & CELL_MASK);
+    }
+    qint64 cellCoord(quint64 key, int shift)
+    {
+        return static_cast<qint64>((key >> shift) & CELL_MASK) - CELL_OFFSET;
+    }
+    QRegularExpression wildcard(const QString &pattern)
+    {
+        return QRegularExpression::fromWildcard(pattern, Qt::CaseInsensitive, QRegularExpression::UnanchoredWildcardConversion);
+    }
+}
+
+bool SceneIndex::Query::isQuery(const QString &text)
+{
+    static const QRegularExpression key("(^|\\s)(type|name|station|file|near):", QRegularExpression::CaseInsensitiveOption);
+    return key.match(text).hasMatch();
+}
+
+SceneIndex::Query SceneIndex::Query::parse(const QString &text)
+{
+    static const QRegularExpression distance("^([0-9]+(?:[.,][0-9]+)?)(km|m)?$", QRegularExpression::CaseInsensitiveOption);
+
+    Query query;
+    QStringList names;
+    for (const auto &word : text.split(' ', Qt::SkipEmptyParts))
+    {
+        auto colon = word.indexOf(':');
+        auto key = colon > 0 ? word.left(colon).toLower() : QString();
+        auto value = word.mid(colon + 1);
+        if(key == "type")
+            query.type = value;
+        else if(key == "name")
+            names << value;
+        else if(key == "station")
+            query.station = value;
+        else if(key == "file")
+            query.file = value;
+        else if(key == "near")
+        {
+            if(auto match = distance.match(value); match.hasMatch())
+                query.near = match.captured(1).replace(',', '.').toDouble() * (match.captured(2).toLower() == "km" ? 1000.0 : 1.0);
+        }
+        else
+            names << word;
+    }
+    query.name = names.join(' ');
+    return query;
+}
+
+void SceneIndex::add(const vsg::Node *node)
+{
+    Entry entry;
+    std::string value;
+    if(node->getValue(app::NAME, value))
+        entry.name = QString::fromStdString(value);
+    if(auto indexed = node->cast<IndexedObject>(); indexed)
+    {
+        entry.type = QString::fromStdString(indexed->objectClass);
+        entry.placed = true;
+        entry.position = indexed->position;
+    }
+    else
+        entry.type = node->className();
+    if(auto object = const_cast<vsg::Node*>(node)->cast<route::SceneObject>(); object)
+    {
+        entry.placed = true;
+        entry.position = object->getWorldPosition();
+    }
+    if(auto signal = node->cast<signalling::Signal>(); signal)
+        entry.station = QString::fromStdString(signal->station);
+    if(auto loader = node->cast<route::SingleLoader>(); loader)
+        entry.file = QString::fromStdString(loader->file);
+
+    auto previous = _entries.find(node);
+    if(previous != _entries.end())
+    {
+        if(previous->name == entry.name && previous->type == entry.type && previous->station == entry.station
+                && previous->file == entry.file && previous->placed == entry.placed && previous->position == entry.position)
+            return;
+        _stale++;
+    }
+    _entries.insert(node, entry);
+
+    auto lower = entry.name.toLower();
+    for (qsizetype i = 0; i + 3 <= lower.size(); ++i)
+    {
+        auto &posting = _grams[trigram(lower.constData() + i)];
+        // a name repeating a trigram is listed once
+        if(posting.empty() || posting.back() != node)
+            posting.push_back(node);
+    }
+    _types[entry.type].push_back(node);
+    if(!entry.station.isEmpty())
+        _stations[entry.station].push_back(node);
+    if(!entry.file.isEmpty())
+        _files[entry.file].push_back(node);
+    if(entry.placed)
+        _cells[cell(entry.position)].push_back(node);
+
+    if(_stale > 1024 && _stale > static_cast<std::size_t>(_entries.size()))
+        rebuild();
+}
+
+void SceneIndex::remove(const vsg::Node *node)
+{
+    if(_entries.remove(node))
+        _stale++;
+}
+
+QSet<const vsg::Node*> SceneIndex::match(const QRegularExpression &expression, const QStringList &literals,
+                                        const std::function<bool()> &cancelled) const
+{
+    QSet<const vsg::Node*> matched;
+    std::size_t tested = 0;
+    auto stop = [&cancelled, &tested]()
+    {
+        return cancelled && (++tested % 4096) == 0 && cancelled();
+    };
+
+    // classes are few, each is tested once
+    for (auto it = _types.cbegin(); it != _types.cend(); ++it)
+    {
+        if(!expression.match(it.key()).hasMatch())
+            continue;
+        for (auto node : it.value())
+            if(auto entry = _entries.constFind(node); entry != _entries.cend() && entry->type == it.key())
+                matched.insert(node);
+    }
+
+    // the rarest trigram of the literals bounds the names to test
+    bool none = false;
+    auto candidates = rarestTrigram(literals, none);
+    if(none)
+        return matched;
+
+    if(!candidates)
+    {
+        for (auto it = _entries.cbegin(); it != _entries.cend() && !stop(); ++it)
+            if(expression.match(it->name).hasMatch())
+                matched.insert(it.key());
+        return matched;
+    }
+
+    for (auto node : *candidates)
+    {
+        if(stop())
+            break;
+        if(auto entry = _entries.constFind(node); entry != _entries.cend() && expression.match(entry->name).hasMatch())
+            matched.insert(node);
+    }
+    return matched;
+}
+
+QSet<const vsg::Node*> SceneIndex::find(const Query &query, const vsg::dvec3 &origin,
+                                        const std::function<bool()> &cancelled) const
+{
+    auto name = wildcard(query.name);
+    auto type = wildcard(query.type);
+    auto station = wildcard(query.station);
+    auto file = wildcard(query.file);
+
+    auto accepts = [&](const Entry &entry)
+    {
+        return (query.name.isEmpty() || name.match(entry.name).hasMatch())
+                && (query.type.isEmpty() || type.match(entry.type).hasMatch())
+                && (query.station.isEmpty() || station.match(entry.station).hasMatch())
+                && (query.file.isEmpty() || file.match(entry.file).hasMatch())
+                && (query.near < 0.0 || (entry.placed && vsg::length(entry.position - origin) <= query.near));
+    };
+
+    // every indexed part offers the postings holding its candidates, the smallest offer is scanned
+    std::vector<const Nodes*> best;
+    auto bestCount = std::numeric_limits<std::size_t>::max();
+    auto offer = [&best, &bestCount](std::vector<const Nodes*> postings)
+    {
+        std::size_t count = 0;
+        for (auto posting : postings)
+            count += posting->size();
+        if(count < bestCount)
+        {
+            best = std::move(postings);
+            bestCount = count;
+        }
+    };
+    auto buckets = [](const QHash<QString, Nodes> &index, const QRegularExpression &expression)
+    {
+        std::vector<const Nodes*> postings;
+        for (auto it = index.cbegin(); it != index.cend(); ++it)
+            if(expression.match(it.key()).hasMatch())
+                postings.push_back(&it.value());
+        return postings;
+    };
+
+    if(!query.type.isEmpty())
+        offer(buckets(_types, type));
+    if(!query.station.isEmpty())
+        offer(buckets(_stations, station));
+    if(!query.file.isEmpty())
+        offer(buckets(_files, file));
+    if(!query.name.isEmpty())
+    {
+        bool none = false;
+        if(auto rarest = rarestTrigram(literals(query.name), none); none)
+            return {};
+        else if(rarest)
+            offer({rarest});
+    }
+    std::size_t tested = 0;
+    auto stop = [&cancelled, &tested]()
+    {
+        return cancelled && (++tested % 4096) == 0 && cancelled();
+    };
+
+    if(query.near >= 0.0)
+    {
+        std::vector<const Nodes*> postings;
+        // no two cells of the grid are further apart than its width, a larger radius takes them all
+        auto reach = static_cast<qint64>(std::min(std::ceil(query.near / CELL_SIZE), static_cast<double>(CELL_MASK + 1)));
+        auto centre = cell(origin);
+        auto x = cellCoord(centre, 42), y = cellCoord(centre, 21), z = cellCoord(centre, 0);
+        // a wide radius over a sparse grid walks the occupied cells instead
+        if(std::pow(2.0 * static_cast<double>(reach) + 1.0, 3) > static_cast<double>(_cells.size()))
+        {
+            for (auto it = _cells.cbegin(); it != _cells.cend(); ++it)
+            {
+                if(stop())
+                    return {};
+                if(std::abs(cellCoord(it.key(), 42) - x) <= reach && std::abs(cellCoord(it.key(), 21) - y) <= reach
+                        && std::abs(cellCoord(it.key(), 0) - z) <= reach)
+                    postings.push_back(&it.value());
+            }
+        }
+        else
+        {
+            for (auto dx = -reach; dx <= reach; ++dx)
+                for (auto dy = -reach; dy <= reach; ++dy)
+                    for (auto dz = -reach; dz <= reach; ++dz)
+                    {
+                        if(stop())
+                            return {};
+                        if(auto found = _cells.constFind(cellKey(x + dx, y + dy, z + dz)); found != _cells.cend())
+                            postings.push_back(&found.value());
+                    }
+        }
+        offer(postings);
+    }
+
+    QSet<const vsg::Node*> found;
+
+    if(bestCount == std::numeric_limits<std::size_t>::max())
+    {
+        for (auto it = _entries.cbegin(); it != _entries.cend() && !stop(); ++it)
+            if(accepts(it.value()))
+                found.insert(it.key());
+        return found;
+    }
+
+    for (auto posting : best)
+    {
+        for (auto node : *posting)
+        {
+            if(stop())
+                return found;
+            if(auto entry = _entries.constFind(node); entry != _entries.cend() && accepts(entry.value()))
+                found.insert(node);
+        }
+    }
+    return found;
+}
+
+QStringList SceneIndex::literals(const QString &wildcard)
+{
+    QStringList parts;
+    QString part;
+    bool set = false;
+    for (auto c : wildcard)
+    {
+        if(set)
+            set = c != ']';
+        else if(c == '[' || c == '*' || c == '?')
+        {
+            set = c == '[';
+            if(!part.isEmpty())
+                parts << part;
+            part.clear();
+        }
+        else
+            part += c;
+    }
+    if(!part.isEmpty())
+        parts << part;
+    return parts;
+}
+
+quint64 SceneIndex::trigram(const QChar *chars)
+{
+    return (quint64(chars[0].unicode()) << 32) | (quint64(chars[1].unicode()) << 16) | chars[2].unicode();
+}
+
+quint64 SceneIndex::cell(const vsg::dvec3 &position)
+{
+    return cellKey(static_cast<qint64>(std::floor(position.x / CELL_SIZE)),
+                   static_cast<qint64>(std::floor(position.y / CELL_SIZE)),
+                   static_cast<qint64>(std::floor(position.z / CELL_SIZE)));
+}
+
+const SceneIndex::Nodes *SceneIndex::rarestTrigram(const QStringList &literals, bool &none) const
+{
+    // none is set when a trigram is missing altogether, nothing can match then
+    const Nodes *rarest = nullptr;
+    for (const auto &literal : literals)
+    {
+        auto lower = literal.toLower();
+        for (qsizetype i = 0; i + 3 <= lower.size(); ++i)
+        {
+            auto posting = _grams.constFind(trigram(lower.constData() + i));
+            if(posting == _grams.cend())
+            {
+                none = true;
+                return nullptr;
+            }
+            if(!rarest || posting->size() < rarest->size())
+                rarest = &posting.value();
+        }
+    }
+    return rarest;
+}
+
+void SceneIndex::rebuild()
+{
+    auto entries = _entries;
+    _entries.clear();
+    _grams.clear();
+    _types.clear();
+    _stations.clear();
+    _files.clear();
+    _cells.clear();
+    _stale = 0;
+    for (auto it = entries.cbegin(); it != entries.cend(); ++it)
+        add(it.key());
+}
@@ -0,0 +1,78 @@
+#ifndef SCENEINDEX_H
+#define SCENEINDEX_H
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QRegularExpression>
+#include <vsg/nodes/Node.h>
+#include <vsg/maths/vec3.h>
+#include <functional>
+
+// names of the nodes in the scene tree by trigram, nodes by class, station and source file,
+// and objects by world position, for the tree filter and queries
+class SceneIndex
+{
+public:
+    // a filter like "type:AutoBlockSignal station:Kirov near:2km", words without a key are names
+    struct Query
+    {
+        QString name;
+        QString type;
+        QString station;
+        QString file;
+        // metres around the origin, none if negative
+        double near = -1.0;
+
+        static bool isQuery(const QString &text);
+        static Query parse(const QString &text);
+    };
+
+    // takes what the tree shows for the node, again after a rename or a move
+    void add(const vsg::Node *node);
+    void remove(const vsg::Node *node);
+
+    // nodes whose name or class matches, the literals must be part of any matching name;
+    // a copy of the index can be matched on another thread, it stops early once cancelled returns true
+    QSet<const vsg::Node*> match(const QRegularExpression &expression, const QStringList &literals,
+                                 const std::function<bool()> &cancelled = {}) const;
+
+    // nodes that meet every part of the query, the most selective part is looked up and the rest checked
+    QSet<const vsg::Node*> find(const Query &query, const vsg::dvec3 &origin,
+                                const std::function<bool()> &cancelled = {}) const;
+
+    // the parts of a wildcard that every match contains
+    static QStringList literals(const QString &wildcard);
+
+    static constexpr double CELL_SIZE = 1000.0;
+
+private:
+    struct Entry
+    {
+        QString name;
+        QString type;
+        QString station;
+        QString file;
+        bool placed = false;
+        vsg::dvec3 position;
+    };
+
+    using Nodes = std::vector<const vsg::Node*>;
+
+    static quint64 trigram(const QChar *chars);
+    static quint64 cell(const vsg::dvec3 &position);
+    const Nodes *rarestTrigram(const QStringList &literals, bool &none) const;
+    void rebuild();
+
+    QHash<const vsg::Node*, Entry> _entries;
+    // postings are only appended, stale ones are skipped on lookup and dropped by rebuilding
+    QHash<quint64, Nodes> _grams;
+    QHash<QString, Nodes> _types;
+    QHash<QString, Nodes> _stations;
+    QHash<QString, Nodes> _files;
+    QHash<quint64, Nodes> _cells;
+    std::size_t _stale = 0;
+};
+
+#endif // SCENEINDEX_H
@@ -3,13 +3,71 @@
 #include "LambdaVisitor.h"
 #include "SceneObjectVisitor.h"
 #include "undo-redo.h"
+#include "MemoryStream.h"
+#include "TileLoader.h"
+#include "RouteIndex.h"
+#include "CompileStats.h"
 #include <QMimeData>
+#include <QSet>
 #include <sstream>
+#include <algorithm>
 #include "trajectory.h"
 #include <vsg/nodes/LOD.h>
 #include <vsg/traversals/CompileTraversal.h>
 #include <vsg/io/VSG.h>
 
+// links every child below a node to its parent and indexes its name, or drops both again
+class ParentLinks : public vsg::Visitor
+{
+public:
+    ParentLinks(QHash<const vsg::Node*, vsg::Node*> &in_parents, SceneIndex &in_names, bool in_forget)
+        : parents(in_parents)
+        , names(in_names)
+        , forget(in_forget) {}
+
+    void apply(vsg::Node &) override
+    {
+    }
+    void apply(vsg::Group &group) override
+    {
+        for (auto &child : group.children)
+            link(child, &group);
+    }
+    void apply(vsg::Switch &sw) override
+    {
+        for (auto &child : sw.children)
+            link(child.node, &sw);
+    }
+    void apply(vsg::LOD &lod) override
+    {
+        for (auto &child : lod.children)
+            link(child.node, &lod);
+    }
+
+    QHash<const vsg::Node*, vsg::Node*> &parents;
+    SceneIndex &names;
+    const bool forget;
+
+private:
+    void link(vsg::Node *child, vsg::Node *parent)
+    {
+        if(!child)
+            return;
+        // a node shared by several parents keeps the link of whoever still holds it
+        if(!forget)
+        {
+            parents.insert(child, parent);
+            names.add(child);
+        }
+        else if(auto it = parents.find(child); it != parents.end() && it.value() == parent)
+        {
+            parents.erase(it);
+            names.remove(child);
+        }
+        child->accept(*this);
+    }
+};
+
 SceneModel::SceneModel(vsg::ref_ptr<vsg::Group> group, vsg::ref_ptr<vsg::Builder> builder, QObject *parent) :
     QAbstractItemModel(parent)
   , _root(group)
@@ -17,12 +75,14 @@ SceneModel::SceneModel(vsg::ref_ptr<vsg::Group> group, vsg::ref_ptr<vsg::Builder
   , _options(builder->options)
   , _undoStack(nullptr)
 {
+    indexParents(_root, nullptr, SceneBvh::ALL);
 }
 SceneModel::SceneModel(vsg::ref_ptr<vsg::Group> group, QObject *parent) :
     QAbstractItemModel(parent)
   , _root(group)
   , _undoStack(nullptr)
 {
+    indexParents(_root, nullptr, SceneBvh::ALL);
 }
 
 SceneModel::~SceneModel()
@@ -42,15 +102,9 @@ QModelIndex SceneModel::index(int row, int column, const QModelIndex &parent) co
 
         auto autoF = [&child, row](const auto& node) { child = node.children.at(row).node; };
         auto groupF = [&child, row](const vsg::Group& node) { child = node.children.at(row); };
-        auto swF = [&child, row](const vsg::Switch& node)
+        auto swF = [this, &child, row](const vsg::Switch& node)
         {
-            auto object = std::find_if(node.children.begin(), node.children.end(), [](const vsg::Switch::Child &ch)
-            {
-                return (ch.mask & route::SceneObjects) != 0;
-            });
-            object += row;
-            Q_ASSERT(object < node.children.cend());
-            child = object->node;
+            child = node.children.at(rowCache(&node).positions.at(row)).node;
         };
 
         CFunctionVisitor<decltype (autoF)> fv(autoF);
@@ -76,19 +130,15 @@ QModelIndex SceneModel::parent(const QModelIndex &child) const
 
     Q_ASSERT(childNode != nullptr);
 
-    vsg::Node *parent = nullptr;
-    childNode->getValue(app::PARENT, parent);
+    auto parent = parentNode(childNode);
     if(!parent)
         return QModelIndex();
 
-    vsg::Node *grandParent = nullptr;
-    parent->getValue(app::PARENT, grandParent);
+    auto grandParent = parentNode(parent);
     if (!grandParent)
         return QModelIndex();
 
-    FindPositionVisitor fpv(parent);
-    fpv.traversalMask = route::SceneObjects;
-    return createIndex(fpv(grandParent), 0, parent);
+    return createIndex(row(parent, grandParent), 0, parent);
 }
 
 bool SceneModel::removeRows(int row, int count, const QModelIndex &parent)
@@ -102,35 +152,33 @@ bool SceneModel::removeRows(int row, int count, const QModelIndex &parent)
     auto autoF = [row, count](auto& node)
     {
         auto begin = node.children.cbegin() + row;
-        auto end = begin + count - 1;
-        Q_ASSERT(end < node.children.end());
-        if(begin == end)
-            node.children.erase(begin);
-        else
-            node.children.erase(begin, end);
+        Q_ASSERT(begin + count <= node.children.cend());
+        node.children.erase(begin, begin + count);
     };
     auto groupF = [autoF](vsg::Group& node) { autoF(node); };
     auto lodF = [autoF](vsg::LOD& node) { autoF(node); };
 
-    auto swF = [row, count](vsg::Switch& node)
+    auto swF = [this, row, count](vsg::Switch& node)
     {
-        auto begin = std::find_if(node.children.begin(), node.children.end(), [](const vsg::Switch::Child &ch)
-        {
-            return (ch.mask & route::SceneObjects) != 0;}
-        );
-        begin += row;
-        auto end = begin + count - 1;
-        Q_ASSERT(end < node.children.end());
-        if(begin == end)
-            node.children.erase(begin);
-        else
-            node.children.erase(begin, end);
+        // rows may be interleaved with terrain, so they are erased one by one from the back
+        auto positions = rowCache(&node).positions;
+        Q_ASSERT(row + count <= static_cast<int>(positions.size()));
+        for (int i = row + count - 1; i >= row; --i)
+            node.children.erase(node.children.begin() + positions[i]);
     };
 
+    // only the part of the range the view has fetched is announced
+    auto fetched = fetchedRows(parentNode);
+    auto shown = std::clamp(fetched - row, 0, count);
+
     FunctionVisitor fv(groupF, swF, lodF);
-    beginRemoveRows(parent, row, row + count - 1);
+    if(shown != 0)
+        beginRemoveRows(parent, row, row + shown - 1);
     parentNode->accept(fv);
-    endRemoveRows();
+    _rows.remove(parentNode);
+    _fetched.insert(parentNode, fetched - shown);
+    if(shown != 0)
+        endRemoveRows();
 
     return true;
 
@@ -138,26 +186,193 @@ bool SceneModel::removeRows(int row, int count, const QModelIndex &parent)
 
 int SceneModel::addNode(const QModelIndex &parent, vsg::ref_ptr<vsg::Node> loaded, uint64_t mask)
 {
-    int row = rowCount(parent);
-
     vsg::Node* parentNode = static_cast<vsg::Node*>(parent.internalPointer());
 
     if (parentNode->is_compatible(typeid (vsg::PagedLOD)))
         return false;
 
-    loaded->setValue(app::PARENT, parentNode);
+    int row = childRows(parentNode);
+    auto fetched = fetchedRows(parentNode);
+    auto shown = fetched == row;
+
+    indexParents(loaded, parentNode, parentNode->is_compatible(typeid (vsg::Switch)) ? mask : traversalMask(parentNode));
 
     auto groupF = [loaded](vsg::Group& group) { group.addChild(loaded); };
     auto swF = [loaded, mask](vsg::Switch& sw) { sw.addChild(mask, loaded); };
     auto lodF = [loaded](vsg::LOD& node) { node.addChild(vsg::LOD::Child{0.0, loaded}); };
 
-    beginInsertRows(parent, row, row);
+    if(shown)
+        beginInsertRows(parent, row, row);
     FunctionVisitor fv(groupF, swF);
     parentNode->accept(fv);
-    endInsertRows();
+    if(auto cached = _rows.find(parentNode); cached != _rows.end())
+    {
+        // appending shifts nothing, the cache only learns the new row
+        cached->children = childCount(parentNode);
+        if(!parentNode->is_compatible(typeid (vsg::Switch)))
+            cached->rows.insert(loaded, row);
+        else if((mask & route::SceneObjects) != 0)
+        {
+            cached->rows.insert(loaded, row);
+            cached->positions.push_back(cached->children - 1);
+        }
+    }
+    if(shown)
+    {
+        _fetched.insert(parentNode, fetched + 1);
+        endInsertRows();
+    }
     return row;
 }
 
+int SceneModel::addNodes(const QModelIndex &parent, const std::vector<vsg::ref_ptr<vsg::Node>> &nodes, int row, uint64_t mask)
+{
+    vsg::Node* parentNode = parent.isValid() ? static_cast<vsg::Node*>(parent.internalPointer()) : _root.get();
+
+    if (nodes.empty() || parentNode->is_compatible(typeid (vsg::PagedLOD)))
+        return -1;
+
+    auto rows = childRows(parentNode);
+    if(row < 0 || row > rows)
+        row = rows;
+
+    // rows among the fetched ones, or appended when nothing is left to fetch, are shown at once
+    auto fetched = fetchedRows(parentNode);
+    auto shown = row < fetched || fetched == rows;
+    auto count = static_cast<int>(nodes.size());
+
+    auto nodeMask = parentNode->is_compatible(typeid (vsg::Switch)) ? mask : traversalMask(parentNode);
+    for (const auto &node : nodes)
+        indexParents(node, parentNode, nodeMask);
+
+    auto groupF = [&nodes, row](vsg::Group& group)
+    {
+        group.children.insert(group.children.begin() + row, nodes.begin(), nodes.end());
+    };
+    auto swF = [this, &nodes, row, mask](vsg::Switch& sw)
+    {
+        // the row is placed before the object that holds it now, terrain stays where it is
+        const auto &positions = rowCache(&sw).positions;
+        auto position = row < static_cast<int>(positions.size()) ? positions[row] : sw.children.size();
+        vsg::Switch::Children children;
+        for (const auto &node : nodes)
+            children.push_back(vsg::Switch::Child{mask, node});
+        sw.children.insert(sw.children.begin() + position, children.begin(), children.end());
+    };
+    auto lodF = [&nodes, row](vsg::LOD& lod)
+    {
+        std::vector<vsg::LOD::Child> children;
+        for (const auto &node : nodes)
+            children.push_back(vsg::LOD::Child{0.0, node});
+        lod.children.insert(lod.children.begin() + row, children.begin(), children.end());
+    };
+
+    if(shown)
+        beginInsertRows(parent, row, row + count - 1);
+    FunctionVisitor fv(groupF, swF, lodF);
+    parentNode->accept(fv);
+    _rows.remove(parentNode);
+    if(shown)
+    {
+        _fetched.insert(parentNode, fetched + count);
+        endInsertRows();
+    }
+    return row;
+}
+
+std::vector<SceneModel::Run> SceneModel::removeNodes(const QModelIndexList &indexes)
+{
+    // a selection holds an index per column
+    QSet<const vsg::Node*> selected;
+    for (const auto &index : indexes)
+        if(index.isValid())
+            selected.insert(static_cast<const vsg::Node*>(index.internalPointer()));
+
+    QHash<vsg::Node*, std::vector<int>> rows;
+    for (auto node : selected)
+    {
+        auto parent = parentNode(node);
+        bool nested = false;
+        for (auto ancestor = parent; ancestor && !nested; ancestor = parentNode(ancestor))
+            nested = selected.contains(ancestor);
+        if(!parent || nested || parent->is_compatible(typeid (vsg::PagedLOD)))
+            continue;
+        if(auto found = row(node, parent); found >= 0)
+            rows[parent].push_back(found);
+    }
+
+    // rows from the root down order the parents the same way on every run
+    std::vector<std::pair<std::vector<int>, vsg::Node*>> parents;
+    for (auto it = rows.begin(); it != rows.end(); ++it)
+    {
+        std::vector<int> path;
+        const vsg::Node *node = it.key();
+        for (auto parent = parentNode(node); parent; node = parent, parent = parentNode(node))
+            path.push_back(row(node, parent));
+        std::reverse(path.begin(), path.end());
+        parents.emplace_back(std::move(path), it.key());
+    }
+    std::sort(parents.begin(), parents.end());
+
+    std::vector<Run> runs;
+    for (const auto &[path, parent] : parents)
+    {
+        auto &parentRows = rows[parent];
+        std::sort(parentRows.begin(), parentRows.end());
+
+        // positions are taken before anything is removed, runs are cut from the back so those in front stay valid
+        auto positions = rowCache(parent).positions;
+        auto sw = parent->cast<vsg::Switch>();
+        auto maskOf = [sw, &positions](int row)
+        {
+            return sw ? sw->children[positions[row]].mask : route::SceneObjects;
+        };
+
+        auto parentIndex = index(parent);
+        auto first = runs.size();
+        for (std::size_t i = 0; i < parentRows.size(); ++i)
+        {
+            auto mask = maskOf(parentRows[i]);
+            if(i == 0 || parentRows[i] != parentRows[i - 1] + 1 || mask != runs.back().mask)
+                runs.push_back(Run{parent, parentRows[i], {}, mask});
+            runs.back().nodes.emplace_back(static_cast<vsg::Node*>(index(parentRows[i], 0, parentIndex).internalPointer()));
+        }
+
+        for (auto run = runs.rbegin(); run != runs.rend() - first; ++run)
+        {
+            auto count = static_cast<int>(run->nodes.size());
+            for (const auto &node : run->nodes)
+                forgetParents(node);
+
+            auto autoF = [&run, count](auto& node)
+            {
+                auto begin = node.children.cbegin() + run->row;
+                node.children.erase(begin, begin + count);
+            };
+            auto groupF = [autoF](vsg::Group& node) { autoF(node); };
+            auto lodF = [autoF](vsg::LOD& node) { autoF(node); };
+            auto swF = [&positions, &run, count](vsg::Switch& node)
+            {
+                for (int i = run->row + count - 1; i >= run->row; --i)
+                    node.children.erase(node.children.begin() + positions[i]);
+            };
+
+            auto fetched = fetchedRows(parent);
+            auto shown = std::clamp(fetched - run->row, 0, count);
+
+            FunctionVisitor fv(groupF, swF, lodF);
+            if(shown != 0)
+                beginRemoveRows(parentIndex, run->row, run->row + shown - 1);
+            parent->accept(fv);
+            _rows.remove(parent);
+            _fetched.insert(parent, fetched - shown);
+            if(shown != 0)
+                endRemoveRows();
+        }
+    }
+    return runs;
+}
+
 QModelIndex SceneModel::removeNode(const QModelIndex &index)
 {
     auto parent = index.parent();
@@ -167,14 +382,160 @@ QModelIndex SceneModel::removeNode(const QModelIndex &index)
 void SceneModel::removeNode(const QModelIndex &index, const QModelIndex &parent)
 {
     vsg::Node* childNode = static_cast<vsg::Node*>(index.internalPointer());
-    childNode->removeObject(app::PARENT);
+    forgetParents(childNode);
     removeRow(index.row(), parent);
 }
 
+NodesMimeData::NodesMimeData(const SceneModel *in_model, const std::vector<vsg::ref_ptr<vsg::Node>> &in_nodes, vsg::ref_ptr<const vsg::Options> in_options)
+    : QMimeData()
+    , model(in_model)
+    , nodes(in_nodes)
+    , _options(in_options)
+{
+}
+
+QStringList NodesMimeData::formats() const
+{
+    // the text carries a single node
+    QStringList types;
+    types << FORMAT;
+    if(nodes.size() == 1)
+        types << "text/plain";
+    return types;
+}
+
+QVariant NodesMimeData::retrieveData(const QString &mimeType, QMetaType type) const
+{
+    if(mimeType != "text/plain" || nodes.size() != 1)
+        return QMimeData::retrieveData(mimeType, type);
+
+    auto options = vsg::Options::create(*_options);
+    options->extensionHint = ".vsgt";
+
+    std::ostringstream oss;
+    vsg::VSG io;
+    io.write(nodes.front(), oss, options);
+    return QByteArray::fromStdString(oss.str());
+}
+
+void SceneModel::indexParents(vsg::Node *node, vsg::Node *parent, uint64_t mask)
+{
+    if(parent)
+    {
+        _parents.insert(node, parent);
+        _names.add(node);
+    }
+    ParentLinks links(_parents, _names, false);
+    node->accept(links);
+    // a node put inside a leaf is measured with it once its command is done
+    if(!parent || !leafOf(parent))
+        _bounds.add(node, vsg::computeTransform(nodePath(node)), mask);
+    emit namesChanged();
+}
+
+void SceneModel::forgetParents(const vsg::Node *node)
+{
+    _parents.remove(node);
+    _names.remove(node);
+    _rows.remove(node);
+    _fetched.remove(node);
+    ParentLinks links(_parents, _names, true);
+    const_cast<vsg::Node*>(node)->accept(links);
+    _bounds.remove(node);
+    emit namesChanged();
+}
+
+uint64_t SceneModel::traversalMask(const vsg::Node *node) const
+{
+    for (auto parent = parentNode(node); parent; node = parent, parent = parentNode(node))
+    {
+        if(auto sw = parent->cast<vsg::Switch>(); sw)
+        {
+            auto child = std::find_if(sw->children.begin(), sw->children.end(), [node](const vsg::Switch::Child &child)
+            {
+                return child.node.get() == node;
+            });
+            return child != sw->children.end() ? child->mask : SceneBvh::ALL;
+        }
+    }
+    return SceneBvh::ALL;
+}
+
+const vsg::Node *SceneModel::leafOf(const vsg::Node *node) const
+{
+    for (; node; node = parentNode(node))
+        if(_bounds.contains(node))
+            return node;
+    return nullptr;
+}
+
+void SceneModel::updateBounds(const vsg::Node *node)
+{
+    // a change inside a leaf measures the leaf again, groups above the leaves were already
+    // taken into the tree when their children were added or removed
+    if(auto leaf = leafOf(node); leaf)
+        _bounds.update(leaf, vsg::computeTransform(nodePath(leaf)));
+}
+
+void SceneModel::setUndoStack(QUndoStack *stack)
+{
+    if(_undoStack)
+        disconnect(_undoStack, nullptr, this, nullptr);
+    _undoStack = stack;
+    if(!stack)
+        return;
+    _undoIndex = stack->index();
+    connect(stack, &QUndoStack::indexChanged, this, [this](int index)
+    {
+        // commands between the previous index and this one were done or undone, a merge changes the last one in place
+        auto from = std::min(_undoIndex, index);
+        auto to = std::max(_undoIndex, index);
+        if(from == to)
+            from = index - 1;
+        _undoIndex = index;
+        for (auto i = std::max(from, 0); i < to && i < _undoStack->count(); ++i)
+            reindex(_undoStack->command(i));
+        emit namesChanged();
+    });
+}
+
+void SceneModel::reindex(const QUndoCommand *command)
+{
+    if(auto scene = dynamic_cast<const SceneCommand*>(command); scene)
+    {
+        for (auto target : scene->targets())
+            if(target && _parents.contains(target))
+            {
+                _names.add(target);
+                // what hangs below a moved node moves with it, its positions are taken again;
+                // rows added or removed were indexed by indexParents and forgetParents already
+                if(scene->movesNodes())
+                {
+                    ParentLinks links(_parents, _names, false);
+                    const_cast<vsg::Node*>(target)->accept(links);
+                }
+                if(!scene->movesNodes() || leafOf(target))
+                    updateBounds(target);
+                else
+                    _bounds.add(const_cast<vsg::Node*>(target), vsg::computeTransform(nodePath(target)), traversalMask(target));
+            }
+    }
+    for (int i = 0; i < command->childCount(); ++i)
+        reindex(command->child(i));
+}
+
+void SceneModel::updateName(const vsg::Node *node)
+{
+    _names.add(node);
+    emit namesChanged();
+
+    if(auto changed = fetchedIndex(node); changed.isValid())
+        emit dataChanged(changed.siblingAtColumn(Name), changed.siblingAtColumn(Name));
+}
+
 QModelIndex SceneModel::index(const vsg::Node *node) const
 {
-    vsg::Node *parent = nullptr;
-    if(node->getValue(app::PARENT, parent))
+    if(auto parent = parentNode(node); parent)
         return SceneModel::index(node, parent);
     else
         return QModelIndex();
@@ -182,9 +543,84 @@ QModelIndex SceneModel::index(const vsg::Node *node) const
 
 QModelIndex SceneModel::index(const vsg::Node *node, const vsg::Node *parent) const
 {
-    FindPositionVisitor fpv(node);
-    fpv.traversalMask = route::SceneObjects;
-    return createIndex(fpv(parent), 0, node);
+    return createIndex(row(node, parent), 0, node);
+}
+
+int SceneModel::row(const vsg::Node *node, const vsg::Node *parent) const
+{
+    const auto &rows = rowCache(parent).rows;
+    if(auto found = rows.find(node); found != rows.end())
+        return found.value();
+
+    // children appended past the model, like the cursor, are picked up by building again
+    _rows.remove(parent);
+    return rowCache(parent).rows.value(node, -1);
+}
+
+const SceneModel::RowCache &SceneModel::rowCache(const vsg::Node *parent) const
+{
+    // a size change means the children were edited past the model, so the cache is stale
+    auto children = childCount(parent);
+    if(auto cached = _rows.constFind(parent); cached != _rows.cend() && cached->children == children)
+        return cached.value();
+
+    RowCache cache;
+    cache.children = children;
+    int row = 0;
+    auto add = [&cache, &row](const vsg::Node *child)
+    {
+        if(!cache.rows.contains(child))
+            cache.rows.insert(child, row);
+        row++;
+    };
+    auto autoF = [add](const auto& node)
+    {
+        for (const auto &child : node.children)
+            add(child.node);
+    };
+    auto groupF = [add](const vsg::Group& node)
+    {
+        for (const auto &child : node.children)
+            add(child);
+    };
+    auto swF = [add, &cache](const vsg::Switch& node)
+    {
+        for (std::size_t i = 0; i < node.children.size(); ++i)
+        {
+            if((node.children[i].mask & route::SceneObjects) != 0)
+            {
+                add(node.children[i].node);
+                cache.positions.push_back(i);
+            }
+        }
+    };
+
+    CFunctionVisitor<decltype (autoF)> fv(autoF);
+    fv.groupFunction = groupF;
+    fv.swFunction = swF;
+    const_cast<vsg::Node*>(parent)->accept(fv);
+
+    return _rows.insert(parent, cache).value();
+}
+
+std::size_t SceneModel::childCount(const vsg::Node *parent)
+{
+    std::size_t count = 0;
+    auto autoF = [&count](const auto& node) { count = node.children.size(); };
+    CFunctionVisitor<decltype (autoF)> fv(autoF);
+    fv.groupFunction = autoF;
+    fv.swFunction = autoF;
+    const_cast<vsg::Node*>(parent)->accept(fv);
+    return count;
+}
+
+std::vector<const vsg::Node*> SceneModel::nodePath(const vsg::Node *node) const
+{
+    std::vector<const vsg::Node*> path;
+    for (auto parent = parentNode(node); parent; parent = parentNode(parent))
+        path.push_back(parent);
+    std::reverse(path.begin(), path.end());
+    return path;
 }
 
 int SceneModel::columnCount ( const QModelIndex & /*parent = QModelIndex()*/ ) const
@@ -200,42 +636,75 @@ Qt::DropActions SceneModel::supportedDropActions() const
 QStringList SceneModel::mimeTypes() const
 {
     QStringList types;
-    types << "text/plain";// << "application/octet-stream";
+    types << NodesMimeData::FORMAT << "text/plain";// << "application/octet-stream";
     return types;
 }
 
 QMimeData *SceneModel::mimeData(const QModelIndexList &indexes) const
 {
-    if(indexes.count() != 1)
-        return 0;
-
-    vsg::VSG io;
-    _options->extensionHint = "vsgt";
-
-    std::ostringstream oss;
-
-    if (indexes.at(0).isValid()) {
-        if(auto node = static_cast<vsg::Node*>(indexes.at(0).internalPointer()); node)
-        {
-            io.write(node, oss, _options);
-        }
-    } else
+    // an index per column, and nodes dragged along with an ancestor go with it
+    QSet<const vsg::Node*> dragged;
+    for (const auto &index : indexes)
+        if(index.isValid())
+            dragged.insert(static_cast<const vsg::Node*>(index.internalPointer()));
+
+    std::vector<vsg::ref_ptr<vsg::Node>> nodes;
+    for (const auto &index : indexes)
+    {
+        auto node = static_cast<vsg::Node*>(index.internalPointer());
+        if(!index.isValid() || !dragged.contains(node))
+            continue;
+        auto path = nodePath(node);
+        if(std::any_of(path.begin(), path.end(), [&dragged](const vsg::Node *ancestor) { return dragged.contains(ancestor); }))
+            continue;
+        dragged.remove(node);
+        nodes.emplace_back(node);
+    }
+    if(nodes.empty())
         return 0;
 
-    QMimeData *mimeData = new QMimeData();
-    mimeData->setText(oss.str().c_str());
-    return mimeData;
+    return new NodesMimeData(this, nodes, _options);
 }
 
 bool SceneModel::dropMimeData(const QMimeData *data, Qt::DropAction action,
                                int row, int column, const QModelIndex &parent)
 {
-    if (!data->hasText() || column > 0 || !parent.isValid())
+    if (column > 0 || !parent.isValid())
         return false;
     else if (action == Qt::IgnoreAction)
         return true;
 
-    std::istringstream iss(data->text().toStdString());
+    Q_ASSERT(_undoStack != nullptr);
+
+    // nodes from this tree are moved as they are, with what is already compiled for them
+    if(auto dragged = dynamic_cast<const NodesMimeData*>(data); dragged && dragged->model == this)
+    {
+        if(action == Qt::MoveAction)
+            return moveNodes(dragged->nodes, parent, row);
+
+        auto binary = vsg::Options::create(*_options);
+        binary->extensionHint = ".vsgb";
+        vsg::VSG io;
+
+        if(dragged->nodes.size() != 1)
+            _undoStack->beginMacro(tr("Скопированы объекты (%1)").arg(dragged->nodes.size()));
+        for (const auto &node : dragged->nodes)
+        {
+            std::stringstream ss;
+            io.write(node, ss, binary);
+            if(auto copy = io.read(ss, binary).cast<vsg::Node>(); copy)
+                addCopy(copy, parent);
+        }
+        if(dragged->nodes.size() != 1)
+            _undoStack->endMacro();
+        return true;
+    }
+
+    if (!data->hasText())
+        return false;
+
+    auto text = data->data("text/plain");
+    MemoryStream iss(text.constData(), static_cast<std::size_t>(text.size()));
 
     vsg::VSG io;
 
@@ -244,51 +713,157 @@ bool SceneModel::dropMimeData(const QMimeData *data, Qt::DropAction action,
     if(!node)
         return false;
 
-    node->accept(*_compile);
+    addCopy(node, parent);
 
-    CalculateTransform ct;
-    node->accept(ct);
+    return true;
+}
 
-    Q_ASSERT(_undoStack != nullptr);
+bool SceneModel::moveNodes(const std::vector<vsg::ref_ptr<vsg::Node>> &nodes, const QModelIndex &parent, int row)
+{
+    auto group = static_cast<vsg::Node*>(parent.internalPointer());
+    if(group->is_compatible(typeid (vsg::PagedLOD)))
+        return false;
 
-    _undoStack->push(new AddSceneObject(this, parent, node));
+    // a node can't be dropped into itself
+    auto path = nodePath(group);
+    path.push_back(group);
+    for (const auto &node : nodes)
+        if(std::find(path.begin(), path.end(), node.get()) != path.end())
+            return false;
 
+    _undoStack->beginMacro(tr("Перемещены объекты (%1)").arg(nodes.size()));
+    _undoStack->push(new MoveNodes(this, nodes, group, row));
+
+    // objects keep their place in the world under the new parent
+    CalculateTransform ct;
+    ct.undoStack = _undoStack;
+    ct.stack.push(vsg::computeTransform(path));
+    for (const auto &node : nodes)
+        node->accept(ct);
+
+    _undoStack->endMacro();
     return true;
 }
-/*
-void SceneModel::fetchMore(const QModelIndex &parent)
+
+void SceneModel::addCopy(vsg::ref_ptr<vsg::Node> node, const QModelIndex &parent)
 {
-    beginInsertRows(parent, 0, rowCount(parent));
-    endInsertRows();
+    node->accept(*_compile);
+    CompileStats::record(node);
+
+    CalculateTransform ct;
+    node->accept(ct);
+
+    _undoStack->push(new AddSceneObject(this, parent, node));
 }
-*/
 
 int SceneModel::rowCount(const QModelIndex &parent) const
 {
-    if (!parent.isValid()) {
-        return _root->children.size();
-    }
-    auto parentNode = static_cast<vsg::Node*>(parent.internalPointer());
+    return fetchedRows(parent.isValid() ? static_cast<vsg::Node*>(parent.internalPointer()) : _root.get());
+}
 
+int SceneModel::childRows(const QModelIndex &parent) const
+{
+    return childRows(parent.isValid() ? static_cast<vsg::Node*>(parent.internalPointer()) : _root.get());
+}
+
+int SceneModel::childRows(const vsg::Node *parent) const
+{
     int rows = 0;
 
     auto autoF = [&rows](const auto& node) { rows = node.children.size(); };
-    auto swF = [&rows](const vsg::Switch& node)
+    auto swF = [this, &rows](const vsg::Switch& node)
     {
-        rows = std::count_if(node.children.begin(), node.children.end(), [](const vsg::Switch::Child &child)
-        {
-            return ((child.mask & route::SceneObjects) != 0);
-        });
+        rows = static_cast<int>(rowCache(&node).positions.size());
     };
 
     CFunctionVisitor<decltype (autoF)> fv(autoF);
     fv.groupFunction = autoF;
     fv.swFunction = swF;
 
-    parentNode->accept(fv);
+    const_cast<vsg::Node*>(parent)->accept(fv);
 
     return rows;
 }
+
+int SceneModel::fetchedRows(const vsg::Node *parent) const
+{
+    // tiles are few, the root shows them all
+    auto rows = childRows(parent);
+    if(parent == _root.get())
+        return rows;
+    return std::min(rows, _fetched.value(parent, 0));
+}
+
+QModelIndex SceneModel::fetchedIndex(const vsg::Node *node) const
+{
+    for (auto child = node, parent = parentNode(child); parent; child = parent, parent = parentNode(child))
+        if(auto found = row(child, parent); found < 0 || found >= fetchedRows(parent))
+            return QModelIndex();
+    return index(node);
+}
+
+bool SceneModel::canFetchMore(const QModelIndex &parent) const
+{
+    auto parentNode = parent.isValid() ? static_cast<vsg::Node*>(parent.internalPointer()) : _root.get();
+    return fetchedRows(parentNode) < childRows(parentNode);
+}
+
+void SceneModel::fetchMore(const QModelIndex &parent)
+{
+    auto parentNode = parent.isValid() ? static_cast<vsg::Node*>(parent.internalPointer()) : _root.get();
+    auto fetched = fetchedRows(parentNode);
+    auto more = std::min(FETCH_CHUNK, childRows(parentNode) - fetched);
+    if(more <= 0)
+        return;
+
+    beginInsertRows(parent, fetched, fetched + more - 1);
+    _fetched.insert(parentNode, fetched + more);
+    endInsertRows();
+}
+
+void SceneModel::fetchTo(const vsg::Node *node)
+{
+    auto path = nodePath(node);
+    path.push_back(node);
+    for (std::size_t i = 1; i < path.size(); ++i)
+    {
+        auto parent = path[i - 1];
+        auto needed = row(path[i], parent) + 1;
+        auto fetched = fetchedRows(parent);
+        if(needed <= fetched)
+            continue;
+
+        beginInsertRows(index(parent), fetched, needed - 1);
+        _fetched.insert(parent, needed);
+        endInsertRows();
+    }
+}
+
+void SceneModel::fetchTo(const QSet<const vsg::Node*> &nodes)
+{
+    QHash<const vsg::Node*, int> needed;
+    for (auto node : nodes)
+        if(auto parent = parentNode(node); parent)
+            needed[parent] = std::max(needed.value(parent, 0), row(node, parent) + 1);
+
+    // a parent's rows can only be inserted once it is a row itself
+    std::vector<std::pair<std::size_t, const vsg::Node*>> parents;
+    for (auto it = needed.cbegin(); it != needed.cend(); ++it)
+        parents.emplace_back(nodePath(it.key()).size(), it.key());
+    std::sort(parents.begin(), parents.end());
+
+    for (const auto &[depth, parent] : parents)
+    {
+        auto fetched = fetchedRows(parent);
+        auto rows = needed.value(parent);
+        if(rows <= fetched)
+            continue;
+        beginInsertRows(index(parent), fetched, rows - 1);
+        _fetched.insert(parent, rows);
+        endInsertRows();
+    }
+}
+
 QVariant SceneModel::data(const QModelIndex &index, int role) const
 {
     if (!index.isValid())
@@ -302,7 +877,11 @@ QVariant SceneModel::data(const QModelIndex &index, int role) const
     case Type:
     {
         if (role == Qt::DisplayRole)
+        {
+            if(auto indexed = nodeInfo->cast<IndexedObject>(); indexed)
+                return indexed->objectClass.c_str();
             return nodeInfo->className();
+        }
         else if(role == Qt::CheckStateRole && index.parent().isValid())
         {
         }
@@ -320,8 +899,12 @@ QVariant SceneModel::data(const QModelIndex &index, int role) const
     }
     case Option:
     {
-        if (role == Qt::DisplayRole || role == Qt::EditRole)
+        if (role == Qt::DisplayRole)
         {
+            if(auto pending = _loading.value(nodeInfo, 0); pending != 0)
+                return tr("Загрузка, осталось тайлов: %1").arg(pending);
+            else if(TileLoader::isStub(nodeInfo))
+                return tr("Не загружен, объектов: %1").arg(TileLoader::stubObjects(nodeInfo));
         }
         break;
     }
@@ -331,6 +914,58 @@ QVariant SceneModel::data(const QModelIndex &index, int role) const
     return QVariant();
 }
 
+void SceneModel::setLoading(const vsg::Node *node, int pending)
+{
+    if(pending == 0)
+        _loading.remove(node);
+    else
+        _loading.insert(node, pending);
+
+    auto changed = fetchedIndex(node);
+    if(changed.isValid())
+        emit dataChanged(changed.siblingAtColumn(Option), changed.siblingAtColumn(Option));
+}
+
+vsg::Switch::Children SceneModel::setChildren(vsg::Switch *parent, const vsg::Switch::Children &children)
+{
+    auto parentIndex = index(parent);
+    auto fetched = fetchedRows(parent);
+
+    for (const auto &child : parent->children)
+        forgetParents(child.node);
+    _rows.remove(parent);
+
+    vsg::Switch::Children previous;
+    if(fetched != 0)
+    {
+        beginRemoveRows(parentIndex, 0, fetched - 1);
+        previous.swap(parent->children);
+        endRemoveRows();
+    }
+    else
+        previous.swap(parent->children);
+
+    auto rows = std::count_if(children.begin(), children.end(), [](const vsg::Switch::Child &child)
+    {
+        return (child.mask & route::SceneObjects) != 0;
+    });
+    // a tile keeps what the view had fetched of it, at least the first chunk
+    auto shown = std::min(static_cast<int>(rows), std::max(fetched, FETCH_CHUNK));
+
+    for (const auto &child : children)
+        indexParents(child.node, parent, child.mask);
+
+    if(shown != 0)
+        beginInsertRows(parentIndex, 0, shown - 1);
+    parent->children = children;
+    _fetched.insert(parent, shown);
+    if(shown != 0)
+        endInsertRows();
+
+    emit dataChanged(parentIndex.siblingAtColumn(Option), parentIndex.siblingAtColumn(Option));
+    return previous;
+}
+
 bool SceneModel::hasChildren(const QModelIndex &parent) const
 {
     if (parent.isValid()) {
@@ -339,6 +974,10 @@ bool SceneModel::hasChildren(const QModelIndex &parent) const
 
         Q_ASSERT(parentNode != nullptr);
 
+        // stubs are expandable, expanding them requests the tile payload
+        if(TileLoader::isStub(parentNode))
+            return true;
+
         bool has = false;
         auto autoF = [&has](const auto &node) { has = !node.children.empty(); };
         auto plodF = [&has](const vsg::PagedLOD& node) { has = false; };
@@ -375,12 +1014,11 @@ bool SceneModel::setData(const QModelIndex &index, const QVariant &value, int ro
     if (index.column() == Name)
     {
         QString newName = value.toString();
-        QUndoCommand *command = new RenameObject(nodeInfo, newName);
+        QUndoCommand *command = new RenameObject(this, nodeInfo, newName);
 
         Q_ASSERT(_undoStack != nullptr);
         _undoStack->push(command);
 
-        emit dataChanged(index, index.sibling(index.row(), ColumnCount));
         return true;
     }
     else if (index.column() == Option)
@@ -401,6 +1039,10 @@ QVariant SceneModel::headerData(int section, Qt::Orientation orientation, int ro
 Qt::ItemFlags SceneModel::flags(const QModelIndex &index) const
 {
     Qt::ItemFlags flags = QAbstractItemModel::flags(index);
+    // objects known only from the route index can't be edited until their tile is loaded,
+    // not even selected, or removing one would drop only the placeholder and the tile brings it back
+    if (index.isValid() && static_cast<vsg::Node*>(index.internalPointer())->is_compatible(typeid (IndexedObject)))
+        return flags & ~Qt::ItemIsSelectable;
     if (index.isValid())
     {
         switch (index.column()) {
@@ -3,9 +3,35 @@
 
 #include <QUndoStack>
 #include <QAbstractItemModel>
+#include <QMimeData>
+#include <QHash>
 #include "sceneobjects.h"
+#include "SceneIndex.h"
+#include "SceneBvh.h"
 #include <vsg/utils/Builder.h>
 
+class SceneModel;
+
+// dragged nodes within the process, the text for other processes is only written when asked for
+class NodesMimeData : public QMimeData
+{
+public:
+    NodesMimeData(const SceneModel *in_model, const std::vector<vsg::ref_ptr<vsg::Node>> &in_nodes, vsg::ref_ptr<const vsg::Options> in_options);
+
+    QStringList formats() const override;
+
+    const SceneModel *model;
+    std::vector<vsg::ref_ptr<vsg::Node>> nodes;
+
+    static constexpr const char* FORMAT = "application/x-route-nodes";
+
+protected:
+    QVariant retrieveData(const QString &mimeType, QMetaType type) const override;
+
+private:
+    vsg::ref_ptr<const vsg::Options> _options;
+};
+
 class SceneModel : public QAbstractItemModel
 {
     Q_OBJECT
@@ -41,21 +67,34 @@ public:
 
     bool dropMimeData(const QMimeData *data, Qt::DropAction action, int row, int column, const QModelIndex &parent);
 
-//    bool canFetchMore(const QModelIndex &parent) const;
+    // children are shown in chunks as the view scrolls, rowCount only counts those fetched
+    bool canFetchMore(const QModelIndex &parent) const;
 
-//    void fetchMore(const QModelIndex &parent);
+    void fetchMore(const QModelIndex &parent);
 
-    /*
-    template<typename F1, typename... Args>
-    void fetchMore(const QModelIndex &parent, F1 function1, Args&... args)
-    {
-        int rows = rowCount(parent);
-        function1(root, args...);
-        beginInsertRows(parent, rows, rowCount(parent));
-        endInsertRows();
-    }*/
+    // fetches the rows of every ancestor up to the node, so it can be selected in the view
+    void fetchTo(const vsg::Node *node);
+    // the same for many nodes with their ancestors among them, one insertion per parent
+    void fetchTo(const QSet<const vsg::Node*> &nodes);
+
+    // all rows of the parent, fetched or not
+    int childRows(const QModelIndex &parent) const;
 
     int addNode(const QModelIndex &parent, vsg::ref_ptr<vsg::Node> loaded, uint64_t mask = route::SceneObjects);
+
+    // children of one parent at consecutive rows, under a switch they also share the mask
+    struct Run
+    {
+        vsg::ref_ptr<vsg::Node> parent;
+        int row = 0;
+        std::vector<vsg::ref_ptr<vsg::Node>> nodes;
+        uint64_t mask = route::SceneObjects;
+    };
+    // inserts the nodes at the row, or appends them for -1, with one model signal
+    int addNodes(const QModelIndex &parent, const std::vector<vsg::ref_ptr<vsg::Node>> &nodes, int row = -1, uint64_t mask = route::SceneObjects);
+    // removes the nodes with one model signal per run, nodes below a removed one are left in it;
+    // parents come in tree order, so a parent's runs are listed before those of parents below it
+    std::vector<Run> removeNodes(const QModelIndexList &indexes);
     /*
     uint32_t setMask(uint32_t mask, int row, const QModelIndex &parent);
     uint32_t setMask(uint32_t mask, const QModelIndex &index);
@@ -70,15 +109,41 @@ public:
     QModelIndex index(const vsg::Node *node) const;
     QModelIndex index(const vsg::Node *node, const vsg::Node *parent) const;
 
+    // parent links are kept here rather than on the nodes, so tiles are written as they are
+    vsg::Node *parentNode(const vsg::Node *node) const { return _parents.value(node, nullptr); }
+    // ancestors from the root down, without the node itself
+    std::vector<const vsg::Node*> nodePath(const vsg::Node *node) const;
+
+    // names and classes of every node in the tree, loaded or not
+    const SceneIndex &names() const { return _names; }
+    // copies of the name index and parent links a worker can read while the tree changes, they are shared until either side writes
+    struct Lookup
+    {
+        SceneIndex names;
+        QHash<const vsg::Node*, vsg::Node*> parents;
+    };
+    Lookup lookup() const { return Lookup{_names, _parents}; }
+    // takes a rename into the index and the view
+    void updateName(const vsg::Node *node);
+    // world bounds of the terrain and objects, for picking
+    const SceneBvh &bounds() const { return _bounds; }
+
 //    void clear();
     bool hasChildren(const QModelIndex &parent) const;
 
     vsg::ref_ptr<vsg::Group> getRoot() { return _root; }
 
-    void setUndoStack(QUndoStack *stack) { _undoStack = stack; }
+    // commands done or undone on the stack are taken into the indexes, moved objects are found where they are now
+    void setUndoStack(QUndoStack *stack);
+
+    void setLoading(const vsg::Node *node, int pending);
+
+    vsg::Switch::Children setChildren(vsg::Switch *parent, const vsg::Switch::Children &children);
 
-/*
 signals:
+    // nodes were added, removed or renamed
+    void namesChanged();
+/*
     void sendCommand(QUndoCommand *command);
     void sendMap(QMap<vsg::Group *, QModelIndex> groupMap);
 */
@@ -97,7 +162,49 @@ private:
     vsg::ref_ptr<vsg::CompileTraversal> _compile;
     vsg::ref_ptr<vsg::Options> _options;
 
+    bool moveNodes(const std::vector<vsg::ref_ptr<vsg::Node>> &nodes, const QModelIndex &parent, int row);
+    void addCopy(vsg::ref_ptr<vsg::Node> node, const QModelIndex &parent);
+
+    // mask is that of the switch child the node is reached through
+    void indexParents(vsg::Node *node, vsg::Node *parent, uint64_t mask);
+    void forgetParents(const vsg::Node *node);
+    uint64_t traversalMask(const vsg::Node *node) const;
+    // the node or its ancestor that is a leaf of the bounds tree
+    const vsg::Node *leafOf(const vsg::Node *node) const;
+    void updateBounds(const vsg::Node *node);
+
+    QHash<const vsg::Node*, vsg::Node*> _parents;
+    SceneIndex _names;
+    SceneBvh _bounds;
+
+    // rows of the children of a parent, built on first use and dropped when its rows shift
+    struct RowCache
+    {
+        std::size_t children = 0;
+        QHash<const vsg::Node*, int> rows;
+        // for switches, where each row is among the children, terrain is not listed
+        std::vector<std::size_t> positions;
+    };
+    int row(const vsg::Node *node, const vsg::Node *parent) const;
+    const RowCache &rowCache(const vsg::Node *parent) const;
+    static std::size_t childCount(const vsg::Node *parent);
+
+    mutable QHash<const vsg::Node*, RowCache> _rows;
+
+    int childRows(const vsg::Node *parent) const;
+    int fetchedRows(const vsg::Node *parent) const;
+    // the index only when the view has fetched the node and its ancestors, signals go out for nothing else
+    QModelIndex fetchedIndex(const vsg::Node *node) const;
+
+    QHash<const vsg::Node*, int> _fetched;
+
+    static constexpr int FETCH_CHUNK = 256;
+
+    QHash<const vsg::Node*, int> _loading;
+
     QUndoStack *_undoStack;
+    int _undoIndex = 0;
+    void reindex(const QUndoCommand *command);
 };
 
 #endif // SCENEMODEL_H
@@ -132,7 +132,11 @@
         : vsg::Visitor()
         , FoundNodes(lsi)
     {
-        std::for_each(lsi->nodePath.begin(), lsi->nodePath.end(), [this](const vsg::Node *node) { const_cast<vsg::Node*>(node)->accept(*this); });
+        std::for_each(lsi->nodePath.begin(), lsi->nodePath.end(), [this](const vsg::Node *node)
+        {
+            const_cast<vsg::Node*>(node)->accept(*this);
+            _previous = node;
+        });
     }
 
     FindNode::FindNode()
@@ -153,14 +157,14 @@
 
     void FindNode::apply(vsg::StateGroup &group)
     {
-        vsg::Node *parent = nullptr;
-        if(group.getValue(app::PARENT, parent) && parent == tile)
+        // the path runs from the root down, so the node before is the parent
+        if(tile && _previous == tile)
             terrain = &group;
     }
 
     void FindNode::apply(vsg::Switch &sw)
     {
-        if(sw.children.front().mask == route::Tiles)
+        if(!sw.children.empty() && sw.children.front().mask == route::Tiles)
             tile = &sw;
     }
 /*
@@ -142,6 +142,9 @@ namespace route {
         void apply(vsg::StateGroup &group) override;
 
         void apply(vsg::Switch &sw) override;
+
+    private:
+        const vsg::Node *_previous = nullptr;
     };
 /*
     class CreateAddCommand : public vsg::ConstVisitor, public vsg::LineSegmentIntersector::Intersection
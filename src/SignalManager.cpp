@@ -8,6 +8,7 @@
 #include <vsg/traversals/ComputeBounds.h>
 #include "ParentVisitor.h"
 #include "DatabaseManager.h"
+#include "CompileStats.h"
 
 SignalManager::SignalManager(DatabaseManager *database, QString root, QWidget *parent) : Tool(database, parent)
     , ui(new Ui::SignalManager)
@@ -68,6 +69,7 @@ void SignalManager::intersection(const FoundNodes &isection)
     lod->bound.radius = length(box.max - box.min) * 0.5;
 */
     _database->builder->compileTraversal->compile(node);
+    CompileStats::record(node);
 
     vsg::ref_ptr<signalling::Signal> sig;
 
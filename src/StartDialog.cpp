@@ -7,6 +7,10 @@
 #include "signals.h"
 #include "interlocking.h"
 #include "topology.h"
+#include "DataSharing.h"
+#include "EditJournal.h"
+#include "CompressedTile.h"
+#include <QMessageBox>
 
 StartDialog::StartDialog(QWidget *parent) :
     QDialog(parent),
@@ -21,6 +25,8 @@ StartDialog::StartDialog(QWidget *parent) :
     // add vsgXchange's support for reading and writing 3rd party file formats
     options->add(vsgXchange::all::create());
 
+    loader = TileLoader::create(options);
+
     QSettings settings(app::ORGANIZATION_NAME, app::APPLICATION_NAME);
     auto HMH = settings.value("HMH", 1.0).toDouble();
     auto NFR = settings.value("NFR", 0.0001).toDouble();
@@ -30,7 +36,13 @@ StartDialog::StartDialog(QWidget *parent) :
     ui->pointsSpinBox->setValue(settings.value("POINTSIZE", 3).toInt());
     ui->lodPointsSpinBox->setValue(settings.value("LOD_POINTS", 0.1).toDouble());
     ui->lodTilesSpinBox->setValue(settings.value("LOD_TILES", 0.5).toDouble());
+    ui->tilesBudgetSpin->setValue(settings.value("TILES_BUDGET", 4096).toInt());
     ui->cursorSpinBox->setValue(settings.value("CURSORSIZE", 3).toInt());
+    ui->progressiveBox->setChecked(settings.value("PROGRESSIVE", false).toBool());
+    ui->lazyBox->setChecked(settings.value("LAZY_TILES", false).toBool());
+    ui->lazyDistanceSpin->setValue(settings.value("LAZY_DISTANCE", 2000.0).toDouble());
+    ui->compressBox->setChecked(settings.value("COMPRESS_TEXTURES", false).toBool());
+    ui->compressTilesBox->setChecked(settings.value("COMPRESS_TILES", false).toBool());
 
     routeModel = new QFileSystemModel(this);
     ui->routeTree->setModel(routeModel);
@@ -54,40 +66,36 @@ void StartDialog::updateSettings()
     settings.setValue("POINTSIZE", ui->pointsSpinBox->value());
     settings.setValue("LOD_POINTS", ui->lodPointsSpinBox->value());
     settings.setValue("LOD_TILES", ui->lodTilesSpinBox->value());
+    settings.setValue("TILES_BUDGET", ui->tilesBudgetSpin->value());
     settings.setValue("CURSORSIZE", ui->cursorSpinBox->value());
+    settings.setValue("PROGRESSIVE", ui->progressiveBox->isChecked());
+    settings.setValue("LAZY_TILES", ui->lazyBox->isChecked());
+    settings.setValue("LAZY_DISTANCE", ui->lazyDistanceSpin->value());
+    settings.setValue("COMPRESS_TEXTURES", ui->compressBox->isChecked());
+    settings.setValue("COMPRESS_TILES", ui->compressTilesBox->isChecked());
 }
 
-void StartDialog::load()
+static vsg::ref_ptr<vsg::Group> readDatabase(const QFileInfo &fi, vsg::ref_ptr<vsg::Options> options)
 {
-    vsg::RegisterWithObjectFactoryProxy<route::SceneObject>();
-    vsg::RegisterWithObjectFactoryProxy<route::SingleLoader>();
-    vsg::RegisterWithObjectFactoryProxy<route::RailPoint>();
-    vsg::RegisterWithObjectFactoryProxy<route::RailConnector>();
-    vsg::RegisterWithObjectFactoryProxy<route::SwitchConnector>();
-
-    vsg::RegisterWithObjectFactoryProxy<signalling::Signal>();
-    vsg::RegisterWithObjectFactoryProxy<signalling::ShSignal>();
-    vsg::RegisterWithObjectFactoryProxy<signalling::Sh2Signal>();
-    vsg::RegisterWithObjectFactoryProxy<signalling::AutoBlockSignal>();
-    vsg::RegisterWithObjectFactoryProxy<signalling::StRepSignal>();
-    vsg::RegisterWithObjectFactoryProxy<signalling::RouteSignal>();
-    vsg::RegisterWithObjectFactoryProxy<signalling::RouteV2Signal>();
-
-    vsg::RegisterWithObjectFactoryProxy<signalling::JunctionCommand>();
-    vsg::RegisterWithObjectFactoryProxy<signalling::SignalCommand>();
-    vsg::RegisterWithObjectFactoryProxy<signalling::RouteCommand>();
-    vsg::RegisterWithObjectFactoryProxy<signalling::Route>();
-    vsg::RegisterWithObjectFactoryProxy<signalling::Routes>();
-    vsg::RegisterWithObjectFactoryProxy<signalling::Station>();
-
-    vsg::RegisterWithObjectFactoryProxy<route::StraitTrajectory>();
-    vsg::RegisterWithObjectFactoryProxy<route::SplineTrajectory>();
-    vsg::RegisterWithObjectFactoryProxy<route::PointsTrajectory>();
-    vsg::RegisterWithObjectFactoryProxy<route::Junction>();
-
-    vsg::RegisterWithObjectFactoryProxy<PointsGroup>();
-    vsg::RegisterWithObjectFactoryProxy<route::Topology>();
+    // compressed tiles sit next to a database in one of the plain formats
+    auto suffixes = CompressedTile::isCompressed(fi.fileName()) ? QStringList{"vsgb", "vsgt"} : QStringList{fi.suffix()};
+    QString databasePath;
+    for (const auto &suffix : suffixes)
+    {
+        databasePath = fi.absolutePath() + QDir::separator() + "database." + suffix;
+        if(QFile::exists(databasePath))
+            break;
+    }
+    auto database = vsg::read_cast<vsg::Group>(databasePath.toStdString(), options);
+    if (!database)
+        throw (DatabaseException(databasePath));
+    database->setValue(app::PATH, databasePath.toStdString());
+    return database;
+}
 
+void StartDialog::load()
+{
+    registerRouteTypes();
 
     QFutureWatcher<vsg::ref_ptr<vsg::Node>> loadWatcher;
     connect(&loadWatcher, &QFutureWatcher<vsg::ref_ptr<vsg::Node>>::progressValueChanged, ui->progressBar, &QProgressBar::setValue);
@@ -100,26 +108,91 @@ void StartDialog::load()
 
     auto selected = ui->routeTree->selectionModel()->selectedRows();
 
-    auto load = [this](const QModelIndex &idx)
+    // edits left by a session that did not close cleanly
+    auto journalPath = EditJournal::filePath(routeModel->fileInfo(selected.front()).absoluteDir());
+    if(auto count = EditJournal::entryCount(journalPath); count != 0)
+    {
+        replayJournal = QMessageBox::question(this, tr("Несохраненные изменения"),
+                                              tr("Найдены несохраненные изменения (%1). Восстановить их?").arg(count)) == QMessageBox::Yes;
+        if(!replayJournal)
+            QFile::remove(journalPath);
+    }
+
+    loader->compressTextures = ui->compressBox->isChecked();
+
+    auto compressTiles = ui->compressTilesBox->isChecked();
+
+    // with a current route index stubs and the object tree come without reading the tiles;
+    // without it or the stub cache every tile would be parsed to make its stub, slower than opening it whole
+    auto routeIndex = ui->lazyBox->isChecked() ? RouteIndex::read(routeModel->fileInfo(selected.front()).absoluteDir()) : vsg::ref_ptr<RouteIndex>();
+    auto lazy = ui->lazyBox->isChecked() && (routeIndex || loader->cacheEnabled());
+    if(ui->lazyBox->isChecked() && !lazy)
+        QMessageBox::information(this, tr("Загрузка по требованию"),
+                                 tr("Нет индекса маршрута (route.idx) и кэша тайлов (RRS2_CACHE), тайлы будут загружены сразу. "
+                                    "Индекс записывается при сохранении маршрута."));
+    auto lazyDistance = lazy ? ui->lazyDistanceSpin->value() : 0.0;
+    // only tiles loaded on demand can be evicted back to stubs
+    std::size_t tilesBudget = lazy ? static_cast<std::size_t>(ui->tilesBudgetSpin->value()) * 1024 * 1024 : 0;
+
+    // stubs are cheap to read, progressive opening only applies to full tiles
+    if(ui->progressiveBox->isChecked() && !lazy)
+    {
+        QStringList tiles;
+        for (const auto &idx : selected)
+            tiles << routeModel->filePath(idx);
+
+        database = QtConcurrent::run([fi=routeModel->fileInfo(selected.front()), options=options, loader=loader, tiles, compressTiles]()
+        {
+            auto manager = DatabaseManager::create(readDatabase(fi, options), vsg::Group::create(), options);
+            manager->loader = loader;
+            manager->compressTiles = compressTiles;
+            manager->setPendingTiles(tiles);
+            return manager;
+        });
+        dbWatcher.setFuture(database);
+        return;
+    }
+
+    auto load = [loader=loader, routeIndex, lazy, this](const QModelIndex &idx) -> vsg::ref_ptr<vsg::Node>
     {
         auto path = routeModel->filePath(idx);
-        auto node = vsg::read_cast<vsg::Node>(path.toStdString(), options);
-        if(!node)
-            throw DatabaseException(path);
-        node->setValue(app::PATH, path.toStdString());
-        return node;
+        if(!lazy)
+            return loader->read(path);
+        if(auto stub = routeIndex ? routeIndex->createStub(path) : vsg::ref_ptr<vsg::Switch>(); stub)
+            return stub;
+        // a tile the index does not know yet, or a cached stub
+        return loader->readStub(path);
     };
     auto loadFuture = QtConcurrent::mapped(selected, load);
-    database = loadFuture.then([fi=routeModel->fileInfo(selected.front()), options=options](QFuture<vsg::ref_ptr<vsg::Node>> f)
+
+    // the database is read and indexed next to the tiles, the continuation only joins it
+    auto databaseFuture = QtConcurrent::run(readDatabase, routeModel->fileInfo(selected.front()), options);
+
+    database = loadFuture.then([databaseFuture, options=options, loader=loader, routeIndex, lazyDistance, tilesBudget, compressTiles](QFuture<vsg::ref_ptr<vsg::Node>> f)
     {
-        auto databasePath = fi.absolutePath() + QDir::separator() + "database." + fi.suffix();
-        auto database = vsg::read_cast<vsg::Group>(databasePath.toStdString(), options);
-        if (!database)
-            throw (DatabaseException(databasePath));
-        database->setValue(app::PATH, databasePath.toStdString());
+        auto database = databaseFuture.result();
         auto group = vsg::Group::create();
         std::move(f.begin(), f.end(), std::back_inserter(group->children));
-        return DatabaseManager::create(database, group, options);
+
+        // tiles are hashed in parallel, identical payloads are then shared in one pass;
+        // stubs carry nothing to share, and tiles read later are compiled as they arrive
+        // so they keep their own copies
+        auto digests = QtConcurrent::blockingMapped<std::vector<DataSharing::TileDigest>>(group->children, [options](const vsg::ref_ptr<vsg::Node> &tile)
+        {
+            return DataSharing::digest(tile, options);
+        });
+        DataSharing sharing;
+        sharing.share(digests);
+
+        auto manager = DatabaseManager::create(database, group, options);
+        manager->sharedBytes = sharing.savedBytes();
+        manager->sharedStates = sharing.sharedStates();
+        manager->loader = loader;
+        manager->compressTiles = compressTiles;
+        manager->lazyDistance = lazyDistance;
+        manager->tilesBudget = tilesBudget;
+        manager->routeIndex = routeIndex;
+        return manager;
     });
 
     loadWatcher.setFuture(loadFuture);
@@ -27,6 +27,7 @@ public:
 
     QFuture<vsg::ref_ptr<DatabaseManager>> database;
     vsg::ref_ptr<vsg::Options> options;
+    vsg::ref_ptr<TileLoader> loader;
 
     enum Colors
     {
@@ -38,6 +39,8 @@ public:
 
     double cursorSize;
 
+    bool replayJournal = false;
+
 public slots:
     void load();
 
@@ -0,0 +1,356 @@
+#include "TextureCompressor.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QFile>
+#include <QHash>
+#include <algorithm>
+#include <cstring>
+#include <set>
+#include <sstream>
+#include <vsg/io/BinaryOutput.h>
+#include <vsg/io/VSG.h>
+#include <vsg/core/Array2D.h>
+#include <vsg/nodes/StateGroup.h>
+#include <vsg/state/BindDescriptorSet.h>
+#include <vsg/state/DescriptorImage.h>
+#include "bc1.h"
+
+namespace {
+    constexpr quint32 MAGIC = 0x42433143; // "BC1C"
+    constexpr quint32 VERSION = 1;
+}
+
+// source pixels of a compressed texture, deflated while nobody paints on them
+class PackedSource : public vsg::Inherit<vsg::Object, PackedSource>
+{
+public:
+    QByteArray pixels;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    vsg::Data::Layout layout;
+    VkImageViewType viewType = VK_IMAGE_VIEW_TYPE_2D;
+
+    vsg::ref_ptr<vsg::ImageView> unpack() const
+    {
+        auto bytes = qUncompress(pixels);
+        auto rgbaLayout = layout;
+        rgbaLayout.allocatorType = vsg::ALLOCATOR_TYPE_VSG_ALLOCATOR;
+        auto data = vsg::ubvec4Array2D::create(width, height, rgbaLayout);
+        std::memcpy(data->dataPointer(), bytes.constData(), std::min(static_cast<std::size_t>(bytes.size()), data->dataSize()));
+
+        auto view = vsg::ImageView::create(vsg::Image::create(data));
+        view->viewType = viewType;
+        return view;
+    }
+};
+
+class CollectImages : public vsg::Visitor
+{
+public:
+    void apply(vsg::Object &object) override
+    {
+        object.traverse(*this);
+    }
+    void apply(vsg::StateGroup &group) override
+    {
+        for (auto &command : group.stateCommands)
+            command->accept(*this);
+        group.traverse(*this);
+    }
+    void apply(vsg::BindDescriptorSet &bds) override
+    {
+        if(bds.descriptorSet)
+            bds.descriptorSet->accept(*this);
+    }
+    void apply(vsg::BindDescriptorSets &bds) override
+    {
+        for (auto &ds : bds.descriptorSets)
+            if(ds)
+                ds->accept(*this);
+    }
+    void apply(vsg::DescriptorSet &ds) override
+    {
+        for (auto &descriptor : ds.descriptors)
+            if(descriptor)
+                descriptor->accept(*this);
+    }
+    void apply(vsg::DescriptorImage &di) override
+    {
+        for (auto &info : di.imageInfoList)
+            if(info && info->imageView && info->imageView->image && visited.insert(info.get()).second)
+                images.push_back(info);
+    }
+
+    std::vector<vsg::ref_ptr<vsg::ImageInfo>> images;
+
+private:
+    std::set<const vsg::ImageInfo*> visited;
+};
+
+static QHash<QByteArray, QByteArray> readCache(const QString &path)
+{
+    QHash<QByteArray, QByteArray> cache;
+
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly))
+        return cache;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0, version = 0;
+    in >> magic >> version;
+    if(magic != MAGIC || version != VERSION)
+        return cache;
+
+    in >> cache;
+    if(in.status() != QDataStream::Ok)
+        cache.clear();
+    return cache;
+}
+
+static void writeCache(const QString &path, const QHash<QByteArray, QByteArray> &cache)
+{
+    QFile file(path + ".part");
+    if(!file.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << MAGIC << VERSION << cache;
+    file.close();
+
+    if(out.status() != QDataStream::Ok)
+    {
+        QFile::remove(file.fileName());
+        return;
+    }
+    QFile::remove(path);
+    QFile::rename(file.fileName(), path);
+}
+
+static vsg::ref_ptr<vsg::Data> createBlocks(const vsg::Data *source, const QByteArray &blocks, uint32_t levels)
+{
+    auto layout = source->getLayout();
+    layout.format = layout.format == VK_FORMAT_R8G8B8A8_SRGB ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    layout.stride = 0;
+    layout.blockWidth = 4;
+    layout.blockHeight = 4;
+    layout.blockDepth = 1;
+    layout.maxNumMipmaps = static_cast<uint8_t>(levels);
+    layout.allocatorType = vsg::ALLOCATOR_TYPE_NEW_DELETE;
+
+    // the mip chain follows level 0 in the same allocation, like in dds files
+    auto values = new vsg::block64[static_cast<std::size_t>(blocks.size()) / sizeof(vsg::block64)];
+    std::memcpy(values, blocks.constData(), static_cast<std::size_t>(blocks.size()));
+    return vsg::block64Array2D::create(source->width() / 4, source->height() / 4, values, layout);
+}
+
+TextureCompressor::TextureCompressor(const QString &tilePath)
+    : _cachePath(tilePath + SUFFIX)
+{
+}
+
+void TextureCompressor::compress(vsg::Node *tile)
+{
+    CollectImages collect;
+    tile->accept(collect);
+
+    auto cache = readCache(_cachePath);
+    QHash<QByteArray, QByteArray> used;
+    QHash<QByteArray, vsg::ref_ptr<vsg::Data>> compressed;
+    QHash<QByteArray, vsg::ref_ptr<PackedSource>> packedSources;
+    bool changed = false;
+
+    for (auto &info : collect.images)
+    {
+        auto view = info->imageView;
+        auto data = view->image->data;
+        if(!data || isCompressed(info) || !data->is_compatible(typeid (vsg::ubvec4Array2D)))
+            continue;
+
+        auto format = data->getLayout().format;
+        if(format != VK_FORMAT_R8G8B8A8_UNORM && format != VK_FORMAT_R8G8B8A8_SRGB)
+            continue;
+        // textures that carry their own mip chain or alpha stay as they are
+        auto pixels = static_cast<const uint8_t*>(data->dataPointer());
+        if(data->getLayout().maxNumMipmaps > 1 || !texcompress::canEncode(data->width(), data->height())
+                || !texcompress::isOpaque(pixels, static_cast<std::size_t>(data->width()) * data->height()))
+            continue;
+
+        auto levels = texcompress::mipLevels(data->width(), data->height());
+        auto key = QCryptographicHash::hash(QByteArray::fromRawData(reinterpret_cast<const char*>(pixels), static_cast<qsizetype>(data->dataSize())),
+                                            QCryptographicHash::Sha1).toHex()
+                + '-' + QByteArray::number(data->width()) + 'x' + QByteArray::number(data->height())
+                + '-' + QByteArray::number(levels) + '-' + QByteArray::number(format);
+
+        auto &blocksData = compressed[key];
+        if(!blocksData)
+        {
+            auto blocks = cache.value(key);
+            if(static_cast<std::size_t>(blocks.size()) != texcompress::encodedSize(data->width(), data->height(), levels))
+            {
+                blocks.resize(static_cast<qsizetype>(texcompress::encodedSize(data->width(), data->height(), levels)));
+                texcompress::encode(pixels, data->width(), data->height(), levels, reinterpret_cast<uint8_t*>(blocks.data()));
+                changed = true;
+            }
+            used.insert(key, blocks);
+            blocksData = createBlocks(data, blocks, levels);
+        }
+
+        // a fast deflate is enough, the point is not keeping the RGBA resident beside the blocks
+        auto &packed = packedSources[key];
+        if(!packed)
+        {
+            packed = PackedSource::create();
+            packed->pixels = qCompress(pixels, static_cast<qsizetype>(data->dataSize()), 1);
+            packed->width = data->width();
+            packed->height = data->height();
+            packed->layout = data->getLayout();
+            packed->viewType = view->viewType;
+        }
+
+        auto image = vsg::Image::create(blocksData);
+        auto compressedView = vsg::ImageView::create(image);
+        compressedView->viewType = view->viewType;
+
+        info->setObject(PACKED, packed);
+        info->imageView = compressedView;
+    }
+
+    // textures that left the tile drop out of the cache as well
+    if(changed || used.size() != cache.size())
+    {
+        if(used.isEmpty())
+            QFile::remove(_cachePath);
+        else
+            writeCache(_cachePath, used);
+    }
+}
+
+bool TextureCompressor::isCompressed(const vsg::ImageInfo *info)
+{
+    return info->getObject<vsg::ImageView>(SOURCE) != nullptr || info->getObject<PackedSource>(PACKED) != nullptr;
+}
+
+vsg::ref_ptr<vsg::ImageView> TextureCompressor::sourceView(vsg::ImageInfo *info)
+{
+    if(auto source = info->getObject<vsg::ImageView>(SOURCE); source)
+        return vsg::ref_ptr<vsg::ImageView>(source);
+    if(auto packed = info->getObject<PackedSource>(PACKED); packed)
+    {
+        auto source = packed->unpack();
+        info->setObject(SOURCE, source);
+        info->removeObject(PACKED);
+        return source;
+    }
+    return info->imageView;
+}
+
+void TextureCompressor::update(vsg::ImageInfo *info, const QRect &rect)
+{
+    auto view = info->getObject<vsg::ImageView>(SOURCE);
+    if(!view)
+        return;
+
+    auto source = view->image->data;
+    auto blocks = info->imageView->image->data;
+    QRect bounds(0, 0, static_cast<int>(source->width()), static_cast<int>(source->height()));
+    auto painted = rect.intersected(bounds);
+    if(painted.isEmpty())
+        return;
+
+    texcompress::encodeRegion(static_cast<const uint8_t*>(source->dataPointer()), source->width(), source->height(),
+                              blocks->getLayout().maxNumMipmaps,
+                              static_cast<uint32_t>(painted.left()), static_cast<uint32_t>(painted.top()),
+                              static_cast<uint32_t>(painted.right() + 1), static_cast<uint32_t>(painted.bottom() + 1),
+                              static_cast<uint8_t*>(blocks->dataPointer()));
+}
+
+// hands every object to the writer through the sources, so a compressed texture is written as its source
+class SourceOutput : public vsg::BinaryOutput
+{
+public:
+    SourceOutput(std::ostream &out, vsg::ref_ptr<const vsg::Options> options, const TextureCompressor::Sources &sources)
+        : vsg::BinaryOutput(out, options)
+        , _sources(sources) {}
+
+    using vsg::BinaryOutput::write;
+    void write(const vsg::Object *object) override
+    {
+        vsg::BinaryOutput::write(_sources.substitute(object));
+    }
+
+private:
+    const TextureCompressor::Sources &_sources;
+};
+
+// the file header is whatever the reader expects from this vsg version
+static const std::string &binaryHeader()
+{
+    static const std::string header = []()
+    {
+        auto options = vsg::Options::create();
+        options->extensionHint = ".vsgb";
+        std::ostringstream oss;
+        vsg::VSG().write(vsg::Object::create(), oss, options);
+        auto bytes = oss.str();
+        return bytes.substr(0, bytes.find('\n') + 1);
+    }();
+    return header;
+}
+
+TextureCompressor::Sources::Sources(vsg::Node *root)
+{
+    CollectImages collect;
+    root->accept(collect);
+
+    for (auto &info : collect.images)
+    {
+        if(!isCompressed(info))
+            continue;
+        // the objects are taken now, later edits of the info don't reach the writers
+        auto &source = _sources.emplace_back();
+        source.view = info->imageView;
+        source.image = info->imageView->image;
+        source.data = info->imageView->image->data;
+        source.source = vsg::ref_ptr<vsg::ImageView>(info->getObject<vsg::ImageView>(SOURCE));
+        source.packed = vsg::ref_ptr<vsg::Object>(info->getObject<PackedSource>(PACKED));
+        _byCompressed.insert(source.view.get(), &source);
+        _byCompressed.insert(source.image.get(), &source);
+        _byCompressed.insert(source.data.get(), &source);
+    }
+}
+
+TextureCompressor::Sources::~Sources()
+{
+}
+
+const vsg::Object *TextureCompressor::Sources::substitute(const vsg::Object *object) const
+{
+    auto found = _byCompressed.constFind(object);
+    if(found == _byCompressed.cend())
+        return object;
+
+    // layers nobody painted are inflated once for all the writers, the tile keeps them packed
+    auto source = found.value();
+    std::call_once(source->inflated, [source]()
+    {
+        if(!source->source)
+            source->source = static_cast<const PackedSource*>(source->packed.get())->unpack();
+    });
+    if(object == source->view.get())
+        return source->source.get();
+    if(object == source->image.get())
+        return source->source->image.get();
+    return source->source->image->data.get();
+}
+
+std::string TextureCompressor::Sources::write(const vsg::Node *node, vsg::ref_ptr<const vsg::Options> options) const
+{
+    std::ostringstream oss;
+    oss << binaryHeader();
+    SourceOutput output(oss, options, *this);
+    output.writeObject("Root", node);
+    return oss.str();
+}
@@ -0,0 +1,68 @@
+#ifndef TEXTURECOMPRESSOR_H
+#define TEXTURECOMPRESSOR_H
+
+#include <QString>
+#include <QRect>
+#include <QHash>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vsg/nodes/Node.h>
+#include <vsg/state/ImageInfo.h>
+#include <vsg/io/Options.h>
+
+// replaces opaque RGBA8 textures of a tile with BC1, the original pixels stay on the ImageInfo
+// deflated so the tile is saved and painted on the exact pixels it was read with
+class TextureCompressor
+{
+public:
+    explicit TextureCompressor(const QString &tilePath);
+
+    // encoded textures are kept beside the tile and reused while their source is unchanged
+    void compress(vsg::Node *tile);
+
+    static bool isCompressed(const vsg::ImageInfo *info);
+    // the RGBA view to paint on, inflated on first use and kept for the layers that get painted
+    static vsg::ref_ptr<vsg::ImageView> sourceView(vsg::ImageInfo *info);
+
+    // re-encodes the blocks under a rectangle of the source after it was painted
+    static void update(vsg::ImageInfo *info, const QRect &rect);
+
+    // writes nodes with the source textures in place of the compressed ones; the graph is left
+    // as it is, so rendering and streaming go on while the writers run
+    class Sources
+    {
+    public:
+        // collected where the graph is edited, what is still packed is inflated by the writers
+        explicit Sources(vsg::Node *root);
+        ~Sources();
+
+        // binary .vsgb bytes of the node, safe to call from several threads
+        std::string write(const vsg::Node *node, vsg::ref_ptr<const vsg::Options> options) const;
+        // the source object to write for a compressed view, image or data, the object itself otherwise
+        const vsg::Object *substitute(const vsg::Object *object) const;
+
+    private:
+        struct Source
+        {
+            // held so no other object takes their addresses while the writers run
+            vsg::ref_ptr<vsg::ImageView> view;
+            vsg::ref_ptr<vsg::Image> image;
+            vsg::ref_ptr<vsg::Data> data;
+            vsg::ref_ptr<vsg::ImageView> source;
+            vsg::ref_ptr<vsg::Object> packed;
+            std::once_flag inflated;
+        };
+        std::deque<Source> _sources;
+        QHash<const vsg::Object*, Source*> _byCompressed;
+    };
+
+    static constexpr const char* SOURCE = "source";
+    static constexpr const char* PACKED = "packedSource";
+    static constexpr const char* SUFFIX = ".bc1";
+
+private:
+    QString _cachePath;
+};
+
+#endif // TEXTURECOMPRESSOR_H
@@ -0,0 +1,260 @@
+#include "TileLoader.h"
+#include "Constants.h"
+#include "MemoryStream.h"
+#include "TextureCompressor.h"
+#include "CompressedTile.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <set>
+#include <vsg/io/read.h>
+#include <vsg/io/VSG.h>
+#include <vsg/traversals/ComputeBounds.h>
+#include "sceneobjects.h"
+
+TileLoader::TileLoader(vsg::ref_ptr<vsg::Options> in_options)
+    : options(in_options)
+    , _binaryOptions(vsg::Options::create(*in_options))
+{
+    _binaryOptions->extensionHint = ".vsgb";
+
+    if(!options->fileCache.empty())
+    {
+        _cacheDir.setPath(QString::fromStdString(options->fileCache) + QDir::separator() + "tiles");
+        _cacheDir.mkpath(".");
+    }
+    else
+        _cacheDir.setPath(QString());
+}
+TileLoader::~TileLoader()
+{
+}
+
+vsg::ref_ptr<vsg::Node> TileLoader::read(const QString &path) const
+{
+    auto node = readTile(path);
+    prepare(node, path);
+    return node;
+}
+
+vsg::ref_ptr<vsg::Node> TileLoader::readTile(const QString &path) const
+{
+    vsg::ref_ptr<vsg::Node> node;
+    if(cacheEnabled() && path.endsWith(".vsgt"))
+        node = readCached(path);
+    else if(path.endsWith(".vsgb"))
+        node = readMapped(path);
+    else if(CompressedTile::isCompressed(path))
+        node = readCompressed(path);
+    else
+        node = vsg::read_cast<vsg::Node>(path.toStdString(), options);
+    if(!node)
+        throw DatabaseException(path);
+    node->setValue(app::PATH, path.toStdString());
+    return node;
+}
+
+void TileLoader::prepare(vsg::Node *node, const QString &path) const
+{
+    if(compressTextures)
+        TextureCompressor(path).compress(node);
+}
+
+vsg::ref_ptr<vsg::Node> TileLoader::readMapped(const QString &path) const
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly))
+        return {};
+
+    auto size = file.size();
+    auto mapped = file.map(0, size);
+    if(!mapped)
+        return vsg::read_cast<vsg::Node>(path.toStdString(), options);
+
+    MemoryStream stream(reinterpret_cast<const char*>(mapped), static_cast<std::size_t>(size));
+    vsg::VSG rw;
+    auto node = rw.read(stream, _binaryOptions).cast<vsg::Node>();
+
+    file.unmap(mapped);
+    return node;
+}
+
+vsg::ref_ptr<vsg::Node> TileLoader::readCompressed(const QString &path) const
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly))
+        return {};
+
+    auto size = file.size();
+    auto mapped = file.map(0, size);
+    if(!mapped)
+        return {};
+
+    std::string bytes;
+    auto ok = CompressedTile::decompress(reinterpret_cast<const char*>(mapped), static_cast<std::size_t>(size), bytes);
+    file.unmap(mapped);
+    if(!ok)
+        return {};
+
+    MemoryStream stream(bytes.data(), bytes.size());
+    vsg::VSG rw;
+    return rw.read(stream, _binaryOptions).cast<vsg::Node>();
+}
+
+QString TileLoader::cacheKey(const QString &path) const
+{
+    QFileInfo fi(path);
+    auto hash = QCryptographicHash::hash(fi.absoluteFilePath().toUtf8(), QCryptographicHash::Sha1).toHex();
+    return QString("%1-%2-%3").arg(hash).arg(fi.lastModified().toMSecsSinceEpoch()).arg(fi.size());
+}
+
+vsg::ref_ptr<vsg::Node> TileLoader::readCached(const QString &path) const
+{
+    auto key = cacheKey(path);
+    auto cached = _cacheDir.filePath(key + ".vsgb");
+    if(QFile::exists(cached))
+    {
+        if(auto node = readMapped(cached); node)
+        {
+            _hits++;
+            return node;
+        }
+    }
+    _misses++;
+
+    auto node = vsg::read_cast<vsg::Node>(path.toStdString(), options);
+    if(node)
+        writeCache(key, ".vsgb", node);
+    return node;
+}
+
+void TileLoader::writeCache(const QString &key, const QString &suffix, const vsg::Node *node) const
+{
+    // entries for older versions of the same tile share the path hash prefix
+    auto prefix = key.section('-', 0, 0);
+    for (const auto &stale : _cacheDir.entryList({prefix + "-*"}, QDir::Files))
+        if(!stale.startsWith(key))
+            _cacheDir.remove(stale);
+
+    auto name = key + suffix;
+    auto part = _cacheDir.filePath(name + ".part.vsgb");
+    vsg::VSG rw;
+    if(rw.write(node, part.toStdString(), options))
+        QFile::rename(part, _cacheDir.filePath(name));
+    else
+        QFile::remove(part);
+}
+
+class DataSize : public vsg::ConstVisitor
+{
+public:
+    void apply(const vsg::Object &object) override
+    {
+        object.traverse(*this);
+    }
+    void apply(const vsg::Data &data) override
+    {
+        if(visited.insert(&data).second)
+            size += data.dataSize();
+    }
+
+    std::set<const vsg::Data*> visited;
+    std::size_t size = 0;
+};
+
+class CountSceneObjects : public vsg::ConstVisitor
+{
+public:
+    void apply(const vsg::Node &node) override
+    {
+        if(node.is_compatible(typeid (route::SceneObject)))
+            count++;
+        node.traverse(*this);
+    }
+
+    int count = 0;
+};
+
+vsg::ref_ptr<vsg::Node> TileLoader::readStub(const QString &path) const
+{
+    QString key;
+    if(cacheEnabled())
+    {
+        key = cacheKey(path);
+        auto cached = _cacheDir.filePath(key + ".stub.vsgb");
+        if(auto stub = QFile::exists(cached) ? readMapped(cached) : vsg::ref_ptr<vsg::Node>(); stub)
+        {
+            stub->setValue(app::PATH, path.toStdString());
+            return stub;
+        }
+    }
+
+    // only switch tiles can be filled in later, anything else is kept as is
+    auto tile = readTile(path);
+    if(!tile->is_compatible(typeid (vsg::Switch)))
+    {
+        prepare(tile, path);
+        return tile;
+    }
+
+    auto stub = createStub(tile);
+    if(cacheEnabled())
+        writeCache(key, ".stub.vsgb", stub);
+    return stub;
+}
+
+vsg::ref_ptr<vsg::Switch> TileLoader::createStub(const vsg::Node *tile)
+{
+    auto stub = vsg::Switch::create();
+
+    std::string value;
+    if(tile->getValue(app::PATH, value))
+        stub->setValue(app::PATH, value);
+    if(tile->getValue(app::NAME, value))
+        stub->setValue(app::NAME, value);
+
+    markStub(stub, tile);
+    return stub;
+}
+
+void TileLoader::markStub(vsg::Node *stub, const vsg::Node *tile)
+{
+    vsg::ComputeBounds computeBounds;
+    computeBounds.traversalMask = route::SceneObjects | route::Tiles;
+    tile->accept(computeBounds);
+    stub->setValue(BOUND_MIN, computeBounds.bounds.min);
+    stub->setValue(BOUND_MAX, computeBounds.bounds.max);
+
+    CountSceneObjects cso;
+    tile->accept(cso);
+    stub->setValue(OBJECTS, cso.count);
+
+    stub->setValue(STUB, true);
+}
+
+bool TileLoader::isStub(const vsg::Node *node)
+{
+    bool stub = false;
+    return node->getValue(STUB, stub) && stub;
+}
+
+vsg::dbox TileLoader::stubBounds(const vsg::Node *node)
+{
+    vsg::dbox bounds;
+    node->getValue(BOUND_MIN, bounds.min);
+    node->getValue(BOUND_MAX, bounds.max);
+    return bounds;
+}
+
+int TileLoader::stubObjects(const vsg::Node *node)
+{
+    int objects = 0;
+    node->getValue(OBJECTS, objects);
+    return objects;
+}
+
+std::size_t TileLoader::dataSize(const vsg::Node *node)
+{
+    DataSize ds;
+    node->accept(ds);
+    return ds.size;
+}
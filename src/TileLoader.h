@@ -0,0 +1,72 @@
+#ifndef TILELOADER_H
+#define TILELOADER_H
+
+#include <QString>
+#include <QDir>
+#include <atomic>
+#include <vsg/nodes/Switch.h>
+#include <vsg/maths/box.h>
+#include <vsg/io/Options.h>
+
+class DatabaseException
+{
+public:
+    DatabaseException(const QString &path)
+        : err_path(path)
+    {
+    }
+    QString getErrPath() { return err_path; }
+private:
+    QString err_path;
+};
+
+class TileLoader : public vsg::Inherit<vsg::Object, TileLoader>
+{
+public:
+    TileLoader(vsg::ref_ptr<vsg::Options> in_options);
+    virtual ~TileLoader();
+
+    vsg::ref_ptr<vsg::Node> read(const QString &path) const;
+    vsg::ref_ptr<vsg::Node> readStub(const QString &path) const;
+
+    static vsg::ref_ptr<vsg::Switch> createStub(const vsg::Node *tile);
+    static void markStub(vsg::Node *stub, const vsg::Node *tile);
+    static bool isStub(const vsg::Node *node);
+    static vsg::dbox stubBounds(const vsg::Node *node);
+    static int stubObjects(const vsg::Node *node);
+
+    static std::size_t dataSize(const vsg::Node *node);
+
+    bool cacheEnabled() const noexcept { return !_cacheDir.path().isEmpty(); }
+    int cacheHits() const noexcept { return _hits; }
+    int cacheMisses() const noexcept { return _misses; }
+
+    vsg::ref_ptr<vsg::Options> options;
+    bool compressTextures = false;
+
+    static constexpr const char* STUB = "stub";
+    static constexpr const char* BOUND_MIN = "boundMin";
+    static constexpr const char* BOUND_MAX = "boundMax";
+    static constexpr const char* OBJECTS = "objects";
+
+private:
+    vsg::ref_ptr<vsg::Node> readTile(const QString &path) const;
+    void prepare(vsg::Node *node, const QString &path) const;
+    // parses the mapped file without an ifstream buffer in between; the reader still copies every
+    // array into storage of its own, so this saves a copy of the file, not resident memory
+    vsg::ref_ptr<vsg::Node> readMapped(const QString &path) const;
+    vsg::ref_ptr<vsg::Node> readCompressed(const QString &path) const;
+
+    QString cacheKey(const QString &path) const;
+    vsg::ref_ptr<vsg::Node> readCached(const QString &path) const;
+    void writeCache(const QString &key, const QString &suffix, const vsg::Node *node) const;
+
+    vsg::ref_ptr<vsg::Options> _binaryOptions;
+
+    QDir _cacheDir;
+
+    mutable std::atomic_int _hits{0};
+    mutable std::atomic_int _misses{0};
+};
+
+#endif // TILELOADER_H
@@ -1,17 +1,115 @@
 #include "TilesSorter.h"
+#include "SceneModel.h"
+#include <QtConcurrent/QtConcurrent>
 
 TilesSorter::TilesSorter(QObject *parent) : QSortFilterProxyModel(parent)
+  , _refilter(new QTimer(this))
+  , _generation(std::make_shared<std::atomic<quint64>>(0))
 {
+    // edits come in bursts, the matches are looked up at most every interval while they last
+    _refilter->setSingleShot(true);
+    _refilter->setInterval(100);
+    connect(_refilter, &QTimer::timeout, this, &TilesSorter::refilter);
+}
+
+void TilesSorter::setSourceModel(QAbstractItemModel *sourceModel)
+{
+    if(auto previous = qobject_cast<SceneModel*>(this->sourceModel()); previous)
+        disconnect(previous, nullptr, _refilter, nullptr);
+    QSortFilterProxyModel::setSourceModel(sourceModel);
+    if(auto model = qobject_cast<SceneModel*>(sourceModel); model)
+        connect(model, &SceneModel::namesChanged, _refilter, [this]()
+        {
+            // a lookup in flight saw the tree before the edit, its nodes and ancestors may be gone
+            ++*_generation;
+            if(!_pattern.isEmpty() && !_refilter->isActive())
+                _refilter->start();
+        });
+    refilter();
+}
+
+void TilesSorter::setFilterPattern(const QString &pattern)
+{
+    // a pattern of stars alone lets everything through
+    _pattern = QString(pattern).remove('*').isEmpty() ? QString() : pattern;
+    refilter();
+}
+
+void TilesSorter::setOrigin(const vsg::dvec3 &origin)
+{
+    _origin = origin;
+    if(SceneIndex::Query::isQuery(_pattern) && SceneIndex::Query::parse(_pattern).near >= 0.0 && !_refilter->isActive())
+        _refilter->start();
+}
+
+void TilesSorter::selectFound()
+{
+    auto model = qobject_cast<SceneModel*>(sourceModel());
+    if(!model || _pattern.isEmpty())
+        return;
+    QItemSelection selection;
+    for (auto node : std::as_const(_found))
+    {
+        model->fetchTo(node);
+        if(auto index = mapFromSource(model->index(node)); index.isValid())
+            selection.select(index, index);
+    }
+    emit viewSelectionSignal(selection, QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows);
+}
+
+void TilesSorter::refilter()
+{
+    _refilter->stop();
+    auto generation = ++*_generation;
+
+    auto model = qobject_cast<SceneModel*>(sourceModel());
+    if(!model || _pattern.isEmpty())
+    {
+        _shown.clear();
+        _found.clear();
+        invalidateRowsFilter();
+        return;
+    }
+
+    // matching and walking up to the ancestors runs on a copy, the gui keeps the previous result meanwhile
+    auto query = SceneIndex::Query::isQuery(_pattern);
+    auto parsed = SceneIndex::Query::parse(_pattern);
+    auto expression = QRegularExpression::fromWildcard(_pattern, filterCaseSensitivity(), QRegularExpression::UnanchoredWildcardConversion);
+    auto literals = SceneIndex::literals(_pattern);
+    auto current = _generation;
+    QtConcurrent::run([lookup = model->lookup(), query, parsed, origin = _origin, expression, literals, current, generation]()
+    {
+        auto cancelled = [&current, generation]() { return *current != generation; };
+        auto found = query ? lookup.names.find(parsed, origin, cancelled) : lookup.names.match(expression, literals, cancelled);
+        QSet<const vsg::Node*> shown;
+        for (const vsg::Node *node : std::as_const(found))
+        {
+            if(cancelled())
+                return std::pair<QSet<const vsg::Node*>, QSet<const vsg::Node*>>();
+            for (; node && !shown.contains(node); node = lookup.parents.value(node, nullptr))
+                shown.insert(node);
+        }
+        return std::make_pair(std::move(shown), std::move(found));
+    }).then(this, [this, current, generation](std::pair<QSet<const vsg::Node*>, QSet<const vsg::Node*>> result)
+    {
+        if(*current != generation)
+            return;
+        // a match past the fetched chunks would never be asked for, the view has no row to expand;
+        // each parent is fetched once up to its last shown row
+        if(auto model = qobject_cast<SceneModel*>(sourceModel()); model)
+            model->fetchTo(result.first);
+        _shown = std::move(result.first);
+        _found = std::move(result.second);
+        invalidateRowsFilter();
+    });
 }
 
 bool TilesSorter::filterAcceptsRow(int source_row, const QModelIndex & source_parent) const
 {
-    bool result = QSortFilterProxyModel::filterAcceptsRow(source_row,source_parent);
-    QModelIndex currentIndex = sourceModel()->index(source_row, 0, source_parent);
-    if (sourceModel()->hasChildren(currentIndex))
-        for (int i = 0; i < sourceModel()->rowCount(currentIndex) && !result; ++i)
-            result = result || filterAcceptsRow(i, currentIndex);
-    return result;
+    if(_pattern.isEmpty())
+        return true;
+    auto node = static_cast<const vsg::Node*>(sourceModel()->index(source_row, 0, source_parent).internalPointer());
+    return _shown.contains(node);
 }
 
 void TilesSorter::select(const QModelIndex &index)
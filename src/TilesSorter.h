@@ -3,6 +3,11 @@
 
 #include <QSortFilterProxyModel>
 #include <QItemSelectionModel>
+#include <QTimer>
+#include <QSet>
+#include <vsg/nodes/Node.h>
+#include <atomic>
+#include <memory>
 
 class TilesSorter: public QSortFilterProxyModel
 {
@@ -10,7 +15,17 @@ class TilesSorter: public QSortFilterProxyModel
 public:
     TilesSorter(QObject *parent = nullptr);
 
+    void setSourceModel(QAbstractItemModel *sourceModel) override;
+
 public slots:
+    // wildcard over names and classes, looked up in the name index of the scene model,
+    // or a query like "type:AutoBlockSignal station:Kirov near:2km"
+    void setFilterPattern(const QString &pattern);
+    // world position a near: query measures from
+    void setOrigin(const vsg::dvec3 &origin);
+    // selects every object the current filter matched, as one selection
+    void selectFound();
+
     void select(const QModelIndex &index);
     void deselect(const QModelIndex &index);
     void expand(const QModelIndex &index);
@@ -24,9 +39,23 @@ signals:
     void doubleClicked(const QModelIndex &index);
 
     void viewSelectSignal(const QModelIndex &index, QItemSelectionModel::SelectionFlags command);
+    void viewSelectionSignal(const QItemSelection &selection, QItemSelectionModel::SelectionFlags command);
     void viewExpandSignal(const QModelIndex &index);
 
 protected:
     virtual bool filterAcceptsRow(int source_row, const QModelIndex & source_parent) const override;
+
+private:
+    void refilter();
+
+    QString _pattern;
+    // matching nodes and their ancestors, kept until a newer lookup finishes
+    QSet<const vsg::Node*> _shown;
+    // the matching nodes alone
+    QSet<const vsg::Node*> _found;
+    vsg::dvec3 _origin;
+    QTimer *_refilter;
+    // bumped by every pattern and edit, a lookup that is no longer current gives up
+    std::shared_ptr<std::atomic<quint64>> _generation;
 };
 #endif // TILESSORTER_H
@@ -4,15 +4,71 @@
 #include "SceneModel.h"
 #include "topology.h"
 #include "DatabaseManager.h"
+#include "EditJournal.h"
+#include <QSet>
+#include <algorithm>
 
-class AddSceneObject : public QUndoCommand
+class SceneCommand : public QUndoCommand
+{
+public:
+    SceneCommand(QUndoCommand *parent = nullptr) : QUndoCommand(parent) {}
+
+    // node changed by the command, used to find the tile it belongs to
+    virtual const vsg::Node *target() const { return nullptr; }
+    // every node changed, for commands that touch several parents
+    virtual std::vector<const vsg::Node*> targets() const { return {target()}; }
+    // whether the database with topology and signalling has to be saved too
+    virtual bool topology() const { return false; }
+    // writes the state the command leaves behind, false if it can't be replayed from the journal;
+    // commands that move no rows may write nothing, replay goes on without them
+    virtual bool journal(EditJournal &journal, bool undone) const { return true; }
+    // whether rows in the tree are added, removed or moved
+    virtual bool movesRows() const { return false; }
+    // whether the targets are placed elsewhere, which moves everything below them too
+    virtual bool movesNodes() const { return false; }
+
+protected:
+    // runs come in tree order, a parent is replayed before the parents below it whose rows it shifts;
+    // nothing is written unless every parent can be located
+    static bool journalRemoved(EditJournal &journal, const std::vector<SceneModel::Run> &runs, const QSet<const vsg::Node*> &absent = {})
+    {
+        for (const auto &run : runs)
+            if(!journal.locatable(run.parent))
+                return false;
+        // the runs of one parent are cut from the back, as removeNodes does
+        for (std::size_t first = 0, last = 0; first < runs.size(); first = last)
+        {
+            while (last < runs.size() && runs[last].parent == runs[first].parent)
+                last++;
+            for (auto run = runs.begin() + last; run != runs.begin() + first; )
+            {
+                --run;
+                for (int row = run->row + static_cast<int>(run->nodes.size()) - 1; row >= run->row; --row)
+                    journal.remove(run->parent, row, absent);
+            }
+        }
+        return true;
+    }
+    static bool journalRestored(EditJournal &journal, const std::vector<SceneModel::Run> &runs)
+    {
+        for (const auto &run : runs)
+            if(!journal.locatable(run.parent))
+                return false;
+        for (const auto &run : runs)
+            for (std::size_t i = 0; i < run.nodes.size(); ++i)
+                journal.insert(run.parent, run.nodes[i], run.row + static_cast<int>(i), run.mask);
+        return true;
+    }
+};
+
+class AddSceneObject : public SceneCommand
 {
 public:
     AddSceneObject(SceneModel *model,
             const QModelIndex &group,
             vsg::ref_ptr<vsg::Node> node,
             QUndoCommand *parent = nullptr)
-        : QUndoCommand(parent)
+        : SceneCommand(parent)
         , _model(model)
         , _group(group)
         , _node(node)
@@ -30,6 +86,18 @@ public:
         : AddSceneObject(model, model->index(group), node, parent)
     {
     }
+    // inserts at the row instead of appending, -1 appends
+    AddSceneObject(SceneModel *model,
+            vsg::Node *group,
+            vsg::ref_ptr<vsg::Node> node,
+            int row,
+            uint64_t mask = route::SceneObjects,
+            QUndoCommand *parent = nullptr)
+        : AddSceneObject(model, model->index(group), node, parent)
+    {
+        _insertAt = row;
+        _mask = mask;
+    }
     void undo() override
     {
         _model->removeNode(_model->index(_row, 0, _group));
@@ -38,19 +106,38 @@ public:
     }
     void redo() override
     {
-        _row = _model->addNode(_group, _node);
+        _row = _insertAt < 0 ? _model->addNode(_group, _node, _mask) : _model->addNodes(_group, {_node}, _insertAt, _mask);
         if(auto trj = _node.cast<route::Trajectory>(); trj)
             trj->attach();
     }
+    const vsg::Node *target() const override
+    {
+        return static_cast<const vsg::Node*>(_group.internalPointer());
+    }
+    bool journal(EditJournal &journal, bool undone) const override
+    {
+        auto group = static_cast<const vsg::Node*>(_group.internalPointer());
+        return undone ? journal.remove(group, _row) : journal.insert(group, _node, _insertAt, _mask);
+    }
+    bool movesRows() const override
+    {
+        return true;
+    }
+    bool topology() const override
+    {
+        return _node->is_compatible(typeid (route::Trajectory));
+    }
 private:
     SceneModel *_model;
     int _row;
+    int _insertAt = -1;
+    uint64_t _mask = route::SceneObjects;
     const QModelIndex _group;
     vsg::ref_ptr<vsg::Node> _node;
 
 };
 
-class AddSignal : public QUndoCommand
+class AddSignal : public SceneCommand
 {
 public:
     AddSignal(route::RailConnector *rc,
@@ -58,7 +145,7 @@ public:
               vsg::ref_ptr<route::Topology> topo,
               bool connect,
               QUndoCommand *parent = nullptr)
-        : QUndoCommand(parent)
+        : SceneCommand(parent)
         , _rc(rc)
         , _sig(sig)
         , _topo(topo)
@@ -85,6 +172,14 @@ public:
             sigs.insert({_sig, _routes});
         }  catch (std::out_of_range) {}
     }
+    const vsg::Node *target() const override
+    {
+        return _rc;
+    }
+    bool topology() const override
+    {
+        return true;
+    }
 protected:
     vsg::ref_ptr<route::RailConnector> _rc;
     vsg::ref_ptr<signalling::Signal> _sig;
@@ -186,10 +281,10 @@ public:
     }
 };
 
-class RemoveNode : public QUndoCommand
+class RemoveNode : public SceneCommand
 {
 public:
-    RemoveNode(SceneModel *model, const QModelIndex &index, QUndoCommand *parent = nullptr) : QUndoCommand(parent)
+    RemoveNode(SceneModel *model, const QModelIndex &index, QUndoCommand *parent = nullptr) : SceneCommand(parent)
         , _model(model)
         , _node(static_cast<vsg::Node*>(index.internalPointer()))
         , _group(index.parent())
@@ -215,6 +310,23 @@ public:
         if(auto trj = _node.cast<route::Trajectory>(); trj)
             trj->detatch();
     }
+    const vsg::Node *target() const override
+    {
+        return static_cast<const vsg::Node*>(_group.internalPointer());
+    }
+    bool journal(EditJournal &journal, bool undone) const override
+    {
+        auto group = static_cast<const vsg::Node*>(_group.internalPointer());
+        return undone ? journal.insert(group, _node, _row) : journal.remove(group, _row);
+    }
+    bool movesRows() const override
+    {
+        return true;
+    }
+    bool topology() const override
+    {
+        return _node->is_compatible(typeid (route::Trajectory));
+    }
 private:
     SceneModel *_model;
     int _row;
@@ -223,10 +335,192 @@ private:
 
 };
 
-class RenameObject : public QUndoCommand
+class RemoveNodes : public SceneCommand
 {
 public:
-    RenameObject(vsg::Object *obj, const QString &name, QUndoCommand *parent = nullptr) : QUndoCommand(parent)
+    RemoveNodes(SceneModel *model, const QModelIndexList &indexes, QUndoCommand *parent = nullptr) : SceneCommand(parent)
+        , _model(model)
+    {
+        QSet<const vsg::Node*> unique;
+        for (const auto &index : indexes)
+        {
+            auto node = static_cast<vsg::Node*>(index.internalPointer());
+            if(!index.isValid() || unique.contains(node))
+                continue;
+            unique.insert(node);
+            _nodes.emplace_back(node);
+            if(auto scobj = node->cast<route::SceneObject>(); scobj)
+                scobj->setSelection(false);
+        }
+        if(_nodes.size() == 1)
+        {
+            std::string name;
+            _nodes.front()->getValue(app::NAME, name);
+            if(name.empty())
+                name = _nodes.front()->className();
+            setText(QObject::tr("Удален объект %1").arg(name.c_str()));
+        }
+        else
+            setText(QObject::tr("Удалены объекты (%1)").arg(_nodes.size()));
+    }
+    void undo() override
+    {
+        // runs are put back in the order they were taken out from, so each lands at its row
+        for (const auto &run : _runs)
+        {
+            _model->addNodes(_model->index(run.parent), run.nodes, run.row, run.mask);
+            for (const auto &node : run.nodes)
+                if(auto trj = node.cast<route::Trajectory>(); trj)
+                    trj->attach();
+        }
+    }
+    void redo() override
+    {
+        QModelIndexList indexes;
+        for (const auto &node : _nodes)
+            indexes.push_back(_model->index(node));
+        _runs = _model->removeNodes(indexes);
+        for (const auto &run : _runs)
+            for (const auto &node : run.nodes)
+                if(auto trj = node.cast<route::Trajectory>(); trj)
+                    trj->detatch();
+    }
+    // removed nodes in the order they were held, only valid after redo
+    std::vector<vsg::ref_ptr<vsg::Node>> removed() const
+    {
+        std::vector<vsg::ref_ptr<vsg::Node>> nodes;
+        for (const auto &run : _runs)
+            nodes.insert(nodes.end(), run.nodes.begin(), run.nodes.end());
+        return nodes;
+    }
+    const vsg::Node *target() const override
+    {
+        return _runs.empty() ? nullptr : _runs.front().parent.get();
+    }
+    std::vector<const vsg::Node*> targets() const override
+    {
+        std::vector<const vsg::Node*> parents;
+        for (const auto &run : _runs)
+            parents.push_back(run.parent);
+        return parents;
+    }
+    bool journal(EditJournal &journal, bool undone) const override
+    {
+        // the nodes go back in the order undo puts them
+        return undone ? journalRestored(journal, _runs) : journalRemoved(journal, _runs);
+    }
+    bool movesRows() const override
+    {
+        return true;
+    }
+    bool topology() const override
+    {
+        return std::any_of(_nodes.begin(), _nodes.end(), [](const auto &node)
+        {
+            return node->is_compatible(typeid (route::Trajectory));
+        });
+    }
+private:
+    SceneModel *_model;
+    std::vector<vsg::ref_ptr<vsg::Node>> _nodes;
+    std::vector<SceneModel::Run> _runs;
+
+};
+class MoveNodes : public SceneCommand
+{
+public:
+    MoveNodes(SceneModel *model, const std::vector<vsg::ref_ptr<vsg::Node>> &nodes, vsg::Node *group, int row, QUndoCommand *parent = nullptr) : SceneCommand(parent)
+        , _model(model)
+        , _nodes(nodes)
+        , _group(group)
+        , _row(row)
+    {
+        setText(QObject::tr("Перемещены объекты (%1)").arg(nodes.size()));
+    }
+    void undo() override
+    {
+        QModelIndexList indexes;
+        for (const auto &node : _moved)
+            indexes.push_back(_model->index(node));
+        _model->removeNodes(indexes);
+        for (const auto &run : _runs)
+            _model->addNodes(_model->index(run.parent), run.nodes, run.row, run.mask);
+    }
+    void redo() override
+    {
+        QModelIndexList indexes;
+        for (const auto &node : _nodes)
+            indexes.push_back(_model->index(node));
+        _runs = _model->removeNodes(indexes);
+
+        // rows taken out in front of the drop row move it up
+        auto row = _row;
+        _moved.clear();
+        for (const auto &run : _runs)
+        {
+            if(row >= 0 && run.parent == _group && run.row < _row)
+                row -= std::min(static_cast<int>(run.nodes.size()), _row - run.row);
+            _moved.insert(_moved.end(), run.nodes.begin(), run.nodes.end());
+        }
+        _movedRow = _model->addNodes(_model->index(_group), _moved, row);
+    }
+    const vsg::Node *target() const override
+    {
+        return _group;
+    }
+    std::vector<const vsg::Node*> targets() const override
+    {
+        std::vector<const vsg::Node*> parents{_group.get()};
+        for (const auto &run : _runs)
+            parents.push_back(run.parent);
+        return parents;
+    }
+    // a removal on one side and an insert on the other, the removals are located
+    // in the tree as it was before the nodes arrived
+    bool journal(EditJournal &journal, bool undone) const override
+    {
+        if(!journal.locatable(_group))
+            return false;
+        QSet<const vsg::Node*> moved(_moved.begin(), _moved.end());
+
+        if(undone)
+        {
+            SceneModel::Run arrived{_group, _movedRow, _moved};
+            return journalRemoved(journal, {arrived}, moved) && journalRestored(journal, _runs);
+        }
+        if(!journalRemoved(journal, _runs, moved))
+            return false;
+        for (std::size_t i = 0; i < _moved.size(); ++i)
+            journal.insert(_group, _moved[i], _movedRow + static_cast<int>(i));
+        return true;
+    }
+    bool movesRows() const override
+    {
+        return true;
+    }
+    bool topology() const override
+    {
+        return std::any_of(_nodes.begin(), _nodes.end(), [](const auto &node)
+        {
+            return node->is_compatible(typeid (route::Trajectory));
+        });
+    }
+private:
+    SceneModel *_model;
+    std::vector<vsg::ref_ptr<vsg::Node>> _nodes;
+    vsg::ref_ptr<vsg::Node> _group;
+    int _row;
+
+    std::vector<SceneModel::Run> _runs;
+    std::vector<vsg::ref_ptr<vsg::Node>> _moved;
+    int _movedRow = 0;
+
+};
+class RenameObject : public SceneCommand
+{
+public:
+    RenameObject(SceneModel *model, vsg::Object *obj, const QString &name, QUndoCommand *parent = nullptr) : SceneCommand(parent)
+        , _model(model)
         , _object(obj)
         , _newName(name.toStdString())
     {
@@ -236,10 +530,14 @@ public:
     void undo() override
     {
         _object->setValue(app::NAME, _oldName);
+        if(auto node = _object->cast<vsg::Node>(); node)
+            _model->updateName(node);
     }
     void redo() override
     {
         _object->setValue(app::NAME, _newName);
+        if(auto node = _object->cast<vsg::Node>(); node)
+            _model->updateName(node);
     }
     int id() const override
     {
@@ -255,7 +553,16 @@ public:
         _newName = rcmd->_newName;
         return true;
     }
+    const vsg::Node *target() const override
+    {
+        return _object->cast<vsg::Node>();
+    }
+    bool journal(EditJournal &journal, bool undone) const override
+    {
+        return journal.name(_object->cast<vsg::Node>(), undone ? _oldName : _newName);
+    }
 private:
+    SceneModel *_model;
     vsg::ref_ptr<vsg::Object> _object;
     std::string _oldName;
     std::string _newName;
@@ -289,10 +596,10 @@ private:
 
 };
 */
-class RotateObject : public QUndoCommand
+class RotateObject : public SceneCommand
 {
 public:
-    RotateObject(route::SceneObject *object, vsg::dquat q, QUndoCommand *parent = nullptr) : QUndoCommand(parent)
+    RotateObject(route::SceneObject *object, vsg::dquat q, QUndoCommand *parent = nullptr) : SceneCommand(parent)
         , _object(object)
         , _oldQ(object->getRotation())
         , _newQ(q)
@@ -323,16 +630,28 @@ public:
         _newQ = rcmd->_newQ;
         return true;
     }
+    const vsg::Node *target() const override
+    {
+        return _object;
+    }
+    bool journal(EditJournal &journal, bool undone) const override
+    {
+        return journal.rotation(_object, undone ? _oldQ : _newQ);
+    }
+    bool movesNodes() const override
+    {
+        return true;
+    }
 private:
     vsg::ref_ptr<route::SceneObject> _object;
     const vsg::dquat _oldQ;
     vsg::dquat _newQ;
 };
 
-class MoveObject : public QUndoCommand
+class MoveObject : public SceneCommand
 {
 public:
-    MoveObject(route::SceneObject *object, const vsg::dvec3& pos, QUndoCommand *parent = nullptr) : QUndoCommand(parent)
+    MoveObject(route::SceneObject *object, const vsg::dvec3& pos, QUndoCommand *parent = nullptr) : SceneCommand(parent)
         , _object(object)
         , _oldPos(object->getPosition())
         , _newPos(pos)
@@ -365,6 +684,18 @@ public:
         _newPos = mcmd->_newPos;
         return true;
     }
+    const vsg::Node *target() const override
+    {
+        return _object;
+    }
+    bool journal(EditJournal &journal, bool undone) const override
+    {
+        return journal.position(_object, undone ? _oldPos : _newPos);
+    }
+    bool movesNodes() const override
+    {
+        return true;
+    }
 
 protected:
     vsg::ref_ptr<route::SceneObject> _object;
@@ -373,10 +704,10 @@ protected:
 
 };
 
-class MoveObjectOnTraj : public QUndoCommand
+class MoveObjectOnTraj : public SceneCommand
 {
 public:
-    MoveObjectOnTraj(vsg::MatrixTransform *object, double coord, QUndoCommand *parent = nullptr) : QUndoCommand(parent)
+    MoveObjectOnTraj(SceneModel *model, vsg::MatrixTransform *object, double coord, QUndoCommand *parent = nullptr) : SceneCommand(parent)
         , _object(object)
         , _newPos(coord)
     {
@@ -387,9 +718,7 @@ public:
         if(!object->getValue(app::PROP, _oldPos))
             _oldPos = 0.0;
 
-        vsg::Node *parentNode = nullptr;
-        object->getValue(app::PARENT, parentNode);
-        _parent = parentNode->cast<route::SplineTrajectory>();
+        _parent = model->parentNode(object)->cast<route::SplineTrajectory>();
     }
     void undo() override
     {
@@ -423,6 +752,18 @@ public:
         _newPos = mcmd->_newPos;
         return true;
     }
+    const vsg::Node *target() const override
+    {
+        return _object;
+    }
+    bool journal(EditJournal &journal, bool undone) const override
+    {
+        return journal.trajectoryCoord(_object, undone ? _oldPos : _newPos);
+    }
+    bool movesNodes() const override
+    {
+        return true;
+    }
 
 protected:
     vsg::ref_ptr<route::SplineTrajectory> _parent;
@@ -431,11 +772,11 @@ protected:
     double _newPos;
 };
 
-class ConnectRails : public QUndoCommand
+class ConnectRails : public SceneCommand
 {
 public:
     ConnectRails(route::RailConnector *conn2, route::SplineTrajectory *connectable, bool front, QUndoCommand *parent = nullptr)
-        : QUndoCommand(parent)
+        : SceneCommand(parent)
         , _conn2(conn2)
         , _traj(connectable)
         , _setfront(front)
@@ -454,6 +795,14 @@ public:
         _setfront ? _traj->setFwdPoint(_conn2) : _traj->setBwdPoint(_conn2);
         _traj->recalculate();
     }
+    const vsg::Node *target() const override
+    {
+        return _traj;
+    }
+    bool topology() const override
+    {
+        return true;
+    }
 private:
     vsg::ref_ptr<route::RailConnector> _conn1;
     vsg::ref_ptr<route::RailConnector> _conn2;
@@ -461,11 +810,11 @@ private:
     vsg::ref_ptr<route::SplineTrajectory> _traj;
 };
 
-class AddRailPoint : public QUndoCommand
+class AddRailPoint : public SceneCommand
 {
 public:
     AddRailPoint(route::SplineTrajectory *trajectory, vsg::ref_ptr<route::RailPoint> point, QUndoCommand *parent = nullptr)
-        : QUndoCommand(parent)
+        : SceneCommand(parent)
         , _trajectory(trajectory)
         , _point(point)
     {
@@ -481,16 +830,24 @@ public:
     {
         _trajectory->add(_point);
     }
+    const vsg::Node *target() const override
+    {
+        return _trajectory;
+    }
+    bool topology() const override
+    {
+        return true;
+    }
 private:
     vsg::ref_ptr<route::SplineTrajectory> _trajectory;
     vsg::ref_ptr<route::RailPoint> _point;
 };
 
-class RemoveRailPoint : public QUndoCommand
+class RemoveRailPoint : public SceneCommand
 {
 public:
     RemoveRailPoint(route::SplineTrajectory *trajectory, route::RailPoint *point, QUndoCommand *parent = nullptr)
-        : QUndoCommand(parent)
+        : SceneCommand(parent)
         , _trajectory(trajectory)
         , _point(point)
     {
@@ -506,6 +863,14 @@ public:
     {
         _trajectory->remove(_point);
     }
+    const vsg::Node *target() const override
+    {
+        return _trajectory;
+    }
+    bool topology() const override
+    {
+        return true;
+    }
 private:
     vsg::ref_ptr<route::SplineTrajectory> _trajectory;
     vsg::ref_ptr<route::RailPoint> _point;
@@ -539,6 +904,11 @@ public:
     {
         return QUndoCommand::id();
     }
+    // the transform goes with the position, a replayed position alone would leave it stale
+    bool journal(EditJournal &journal, bool undone) const override
+    {
+        return journal.transform(_object, undone ? _oldPos : _newPos, undone ? _oldLtw : _newLtw);
+    }
 
 private:
     const vsg::dmat4 _oldLtw;
@@ -546,14 +916,15 @@ private:
 };
 
 template<typename F, typename V>
-class ExecuteLambda : public QUndoCommand
+class ExecuteLambda : public SceneCommand
 {
 public:
-    ExecuteLambda(F func, V old, V val, int id, QUndoCommand *parent = nullptr) : QUndoCommand(parent)
+    ExecuteLambda(F func, V old, V val, int id, const vsg::Node *target, QUndoCommand *parent = nullptr) : SceneCommand(parent)
         , _newProp(val)
         , _oldProp(old)
         , _func(func)
         , _id(id)
+        , _target(target)
     {
     }
     void undo() override
@@ -576,10 +947,15 @@ public:
         _newProp = excmd->_newProp;
         return true;
     }
+    const vsg::Node *target() const override
+    {
+        return _target;
+    }
 
 protected:
     F _func;
     int _id;
+    const vsg::Node *_target;
 
     const V _oldProp;
     V _newProp;
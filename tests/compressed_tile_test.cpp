@@ -0,0 +1,153 @@
+#include "CompressedTile.h"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+// checks the .vsgz framing on made up payloads, no tiles are needed
+
+namespace {
+    int failures = 0;
+
+    void check(bool ok, const char *what)
+    {
+        if(ok)
+            return;
+        std::cerr << "FAILED: " << what << std::endl;
+        failures++;
+    }
+
+    std::string payload(std::size_t size, quint32 seed)
+    {
+        // runs of repeated bytes between noise, so blocks neither vanish nor grow much
+        std::string bytes(size, '\0');
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            bytes[i] = (i / 64) % 2 ? static_cast<char>(i / 4096) : static_cast<char>(seed >> 24);
+        }
+        return bytes;
+    }
+
+    bool decompress(const QByteArray &container, std::string &out)
+    {
+        return CompressedTile::decompress(container.constData(), static_cast<std::size_t>(container.size()), out);
+    }
+
+    // fields are written big endian by QDataStream
+    void setField(QByteArray &container, int offset, quint32 value)
+    {
+        for (int i = 0; i < 4; ++i)
+            container[offset + i] = static_cast<char>(value >> (24 - 8 * i));
+    }
+
+    quint32 field(const QByteArray &container, int offset)
+    {
+        quint32 value = 0;
+        for (int i = 0; i < 4; ++i)
+            value = value << 8 | static_cast<uchar>(container[offset + i]);
+        return value;
+    }
+
+    // magic, version, codec and block size, then the raw size as two fields, the count and the table
+    constexpr int VERSION_AT = 4;
+    constexpr int CODEC_AT = 8;
+    constexpr int BLOCK_SIZE_AT = 12;
+    constexpr int RAW_SIZE_AT = 16;
+    constexpr int COUNT_AT = 24;
+    constexpr int TABLE_AT = 28;
+
+    void roundTrip(std::size_t size)
+    {
+        auto raw = payload(size, static_cast<quint32>(size));
+        auto container = CompressedTile::compress(raw.data(), raw.size());
+
+        std::string out = "left over";
+        check(decompress(container, out), "a written container is read back");
+        check(out == raw, "the payload survives a round trip");
+
+        auto blocks = (size + CompressedTile::BLOCK_SIZE - 1) / CompressedTile::BLOCK_SIZE;
+        check(field(container, COUNT_AT) == blocks, "the payload is cut into blocks of BLOCK_SIZE");
+    }
+
+    void truncated()
+    {
+        auto raw = payload(CompressedTile::BLOCK_SIZE * 2 + 1000, 7);
+        auto container = CompressedTile::compress(raw.data(), raw.size());
+        std::string out;
+
+        check(!decompress(container.left(TABLE_AT - 5), out), "a cut header is rejected");
+        check(!decompress(container.left(TABLE_AT + 6), out), "a cut block table is rejected");
+        check(!decompress(container.left(container.size() - 1), out), "a cut last block is rejected");
+        check(!decompress(QByteArray(), out), "an empty file is rejected");
+    }
+
+    void damagedHeader()
+    {
+        auto raw = payload(CompressedTile::BLOCK_SIZE + 10, 3);
+        auto container = CompressedTile::compress(raw.data(), raw.size());
+        std::string out;
+
+        auto damaged = container;
+        damaged[0] = 'x';
+        check(!decompress(damaged, out), "a wrong magic is rejected");
+
+        damaged = container;
+        setField(damaged, VERSION_AT, field(container, VERSION_AT) + 1);
+        check(!decompress(damaged, out), "a newer version is rejected");
+
+        damaged = container;
+        setField(damaged, CODEC_AT, 99);
+        check(!decompress(damaged, out), "an unknown codec is rejected");
+
+        damaged = container;
+        setField(damaged, BLOCK_SIZE_AT, 0);
+        check(!decompress(damaged, out), "a block size of zero is rejected");
+
+        damaged = container;
+        setField(damaged, COUNT_AT, field(container, COUNT_AT) + 1);
+        check(!decompress(damaged, out), "a count that does not fit the raw size is rejected");
+
+        // a huge raw size with a matching count must fail on the table, before anything is allocated
+        damaged = container;
+        auto rawSize = 0x10ull << 32 | field(container, RAW_SIZE_AT + 4);
+        setField(damaged, RAW_SIZE_AT, 0x10);
+        setField(damaged, COUNT_AT, static_cast<quint32>((rawSize + CompressedTile::BLOCK_SIZE - 1) / CompressedTile::BLOCK_SIZE));
+        check(!decompress(damaged, out), "a raw size beyond the file is rejected");
+    }
+
+    void damagedTable()
+    {
+        auto raw = payload(CompressedTile::BLOCK_SIZE * 2 + 1000, 11);
+        auto container = CompressedTile::compress(raw.data(), raw.size());
+        std::string out;
+
+        auto damaged = container;
+        setField(damaged, TABLE_AT, field(container, TABLE_AT) + static_cast<quint32>(container.size()));
+        check(!decompress(damaged, out), "a block running past the file is rejected");
+
+        damaged = container;
+        setField(damaged, TABLE_AT, field(container, TABLE_AT) - 16);
+        check(!decompress(damaged, out), "a block cut short by its size is rejected");
+
+        damaged = container;
+        auto first = TABLE_AT + 4 * static_cast<int>(field(container, COUNT_AT));
+        damaged[first + 100] = static_cast<char>(damaged[first + 100] ^ 0x55);
+        check(!decompress(damaged, out), "a damaged block is rejected");
+    }
+}
+
+int main()
+{
+    roundTrip(0);
+    roundTrip(1);
+    roundTrip(CompressedTile::BLOCK_SIZE);
+    roundTrip(CompressedTile::BLOCK_SIZE * 5 / 2);
+
+    truncated();
+    damagedHeader();
+    damagedTable();
+
+    if(failures == 0)
+        std::cout << "compressed tile: all checks passed" << std::endl;
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
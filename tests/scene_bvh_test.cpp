@@ -0,0 +1,209 @@
+#include "SceneBvh.h"
+#include <vsg/commands/VertexIndexDraw.h>
+#include <vsg/core/Array.h>
+#include <vsg/maths/transform.h>
+#include <vsg/traversals/LineSegmentIntersector.h>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+
+// checks the tree on random boxes against a brute force test of every box, no window or gpu is needed
+
+namespace {
+    int failures = 0;
+
+    void check(bool ok, const char *what)
+    {
+        if(ok)
+            return;
+        std::cerr << "FAILED: " << what << std::endl;
+        failures++;
+    }
+
+    struct Leaf
+    {
+        vsg::ref_ptr<vsg::Node> node;
+        // the box of the vertices, placed by the translation
+        vsg::dbox local;
+        vsg::dvec3 translation;
+        uint64_t mask = 0;
+        bool bounded = true;
+    };
+
+    vsg::ref_ptr<vsg::Node> box(const vsg::dbox &local)
+    {
+        auto draw = vsg::VertexIndexDraw::create();
+        auto vertices = vsg::vec3Array::create(2);
+        vertices->at(0) = vsg::vec3(local.min);
+        vertices->at(1) = vsg::vec3(local.max);
+        draw->assignArrays({vertices});
+        return draw;
+    }
+
+    // slab test of the segment against the box
+    bool hits(const vsg::dvec3 &start, const vsg::dvec3 &end, const vsg::dbox &bounds)
+    {
+        double from = 0.0, to = 1.0;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            auto direction = end[axis] - start[axis];
+            if(direction == 0.0)
+            {
+                if(start[axis] < bounds.min[axis] || start[axis] > bounds.max[axis])
+                    return false;
+                continue;
+            }
+            auto t0 = (bounds.min[axis] - start[axis]) / direction;
+            auto t1 = (bounds.max[axis] - start[axis]) / direction;
+            from = std::max(from, std::min(t0, t1));
+            to = std::min(to, std::max(t0, t1));
+            if(from > to)
+                return false;
+        }
+        return true;
+    }
+
+    class Scene
+    {
+    public:
+        explicit Scene(unsigned seed) : random(seed) {}
+
+        void insert()
+        {
+            Leaf leaf;
+            // the vertices are floats, the box is kept as they hold it
+            vsg::dvec3 half(vsg::vec3(vsg::dvec3(coord(0.25, 10.0), coord(0.25, 10.0), coord(0.25, 10.0))));
+            leaf.local = vsg::dbox(-half, half);
+            leaf.translation = position();
+            leaf.mask = uint64_t(1) << static_cast<int>(random() % 4);
+            // now and then a node without vertices, it can't be measured
+            leaf.bounded = random() % 16 != 0;
+            leaf.node = leaf.bounded ? box(leaf.local) : vsg::ref_ptr<vsg::Node>(vsg::VertexIndexDraw::create());
+            bvh.add(leaf.node, vsg::translate(leaf.translation), leaf.mask);
+            leaves.emplace(leaf.node.get(), leaf);
+        }
+
+        void update()
+        {
+            if(leaves.empty())
+                return;
+            auto &leaf = pick();
+            leaf.translation = random() % 2 ? position() : leaf.translation + vsg::dvec3(coord(-5.0, 5.0), coord(-5.0, 5.0), 0.0);
+            bvh.update(leaf.node, vsg::translate(leaf.translation));
+        }
+
+        void remove()
+        {
+            if(leaves.empty())
+                return;
+            auto node = pick().node;
+            bvh.remove(node);
+            leaves.erase(node.get());
+        }
+
+        void query(const char *what)
+        {
+            auto start = position() + vsg::dvec3(0.0, 0.0, 600.0);
+            auto end = position() - vsg::dvec3(0.0, 0.0, 600.0);
+            uint64_t mask = random() % 3 == 0 ? SceneBvh::ALL : uint64_t(random() % 16);
+
+            auto intersector = vsg::LineSegmentIntersector::create(start, end);
+            auto found = bvh.intersect(*intersector, mask);
+            std::set<const vsg::Node*> candidates(found.begin(), found.end());
+
+            bool superset = true;
+            for (const auto &[node, leaf] : leaves)
+            {
+                if((leaf.mask & mask) == 0)
+                    continue;
+                auto placed = vsg::dbox(leaf.local.min + leaf.translation, leaf.local.max + leaf.translation);
+                if((!leaf.bounded || hits(start, end, placed)) && !candidates.count(node))
+                    superset = false;
+            }
+            check(superset, what);
+            check(candidates.size() == found.size(), "no leaf is returned twice");
+        }
+
+        SceneBvh bvh;
+        std::map<const vsg::Node*, Leaf> leaves;
+
+    private:
+        double coord(double from, double to)
+        {
+            return std::uniform_real_distribution<double>(from, to)(random);
+        }
+        vsg::dvec3 position()
+        {
+            return vsg::dvec3(coord(-500.0, 500.0), coord(-500.0, 500.0), coord(-50.0, 50.0));
+        }
+        Leaf &pick()
+        {
+            auto it = leaves.begin();
+            std::advance(it, static_cast<long>(random() % leaves.size()));
+            return it->second;
+        }
+
+        std::mt19937 random;
+    };
+
+    void grows()
+    {
+        Scene scene(1);
+        for (int i = 0; i < 500; ++i)
+            scene.insert();
+        check(scene.bvh.consistent(), "links, heights, masks and boxes agree after inserts");
+        check(scene.bvh.size() == scene.leaves.size(), "every inserted leaf is held");
+        for (int i = 0; i < 200; ++i)
+            scene.query("a query after inserts returns every leaf the segment hits");
+    }
+
+    void churns()
+    {
+        Scene scene(2);
+        for (int round = 0; round < 40; ++round)
+        {
+            for (int i = 0; i < 50; ++i)
+            {
+                switch (i % 4) {
+                case 0:
+                case 1:
+                    scene.insert();
+                    break;
+                case 2:
+                    scene.update();
+                    break;
+                default:
+                    scene.remove();
+                    break;
+                }
+            }
+            check(scene.bvh.consistent(), "links, heights, masks and boxes agree after mixed edits");
+            check(scene.bvh.size() == scene.leaves.size(), "the tree holds the leaves that were not removed");
+            for (int i = 0; i < 20; ++i)
+                scene.query("a query after mixed edits returns every leaf the segment hits");
+        }
+
+        // emptied and filled again, the freed items are reused
+        while (!scene.leaves.empty())
+            scene.remove();
+        check(scene.bvh.consistent() && scene.bvh.size() == 0, "an emptied tree keeps all its items free");
+        for (int i = 0; i < 100; ++i)
+            scene.insert();
+        check(scene.bvh.consistent(), "freed items are taken again");
+        for (int i = 0; i < 50; ++i)
+            scene.query("a query after refilling returns every leaf the segment hits");
+    }
+}
+
+int main()
+{
+    grows();
+    churns();
+
+    if(failures == 0)
+        std::cout << "scene bvh: all checks passed" << std::endl;
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
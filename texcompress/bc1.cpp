@@ -0,0 +1,330 @@
+#include "bc1.h"
+#include <algorithm>
+#include <vector>
+
+namespace texcompress {
+
+    namespace {
+        struct Color
+        {
+            int r = 0, g = 0, b = 0;
+        };
+
+        uint16_t pack565(const Color &c)
+        {
+            auto r = (c.r * 31 + 127) / 255;
+            auto g = (c.g * 63 + 127) / 255;
+            auto b = (c.b * 31 + 127) / 255;
+            return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+        }
+
+        Color unpack565(uint16_t v)
+        {
+            auto r = (v >> 11) & 0x1f;
+            auto g = (v >> 5) & 0x3f;
+            auto b = v & 0x1f;
+            return {(r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2)};
+        }
+
+        Color mix(const Color &a, const Color &b, int wa, int wb)
+        {
+            auto sum = wa + wb;
+            return {(a.r * wa + b.r * wb) / sum, (a.g * wa + b.g * wb) / sum, (a.b * wa + b.b * wb) / sum};
+        }
+
+        int distance(const Color &a, const uint8_t *p)
+        {
+            auto dr = a.r - p[0];
+            auto dg = a.g - p[1];
+            auto db = a.b - p[2];
+            return dr * dr + dg * dg + db * db;
+        }
+
+        uint32_t blocksAcross(uint32_t size, uint32_t level)
+        {
+            return (std::max(1u, size >> level) + 3) / 4;
+        }
+
+        std::size_t levelOffset(uint32_t width, uint32_t height, uint32_t level)
+        {
+            std::size_t offset = 0;
+            for (uint32_t l = 0; l < level; ++l)
+                offset += static_cast<std::size_t>(blocksAcross(width, l)) * blocksAcross(height, l) * BLOCK_SIZE;
+            return offset;
+        }
+
+        void encodeLevel(const uint8_t *rgba, uint32_t width, uint32_t height, uint8_t *blocks)
+        {
+            uint8_t pixels[16 * 4];
+            auto bw = blocksAcross(width, 0);
+            auto bh = blocksAcross(height, 0);
+            for (uint32_t by = 0; by < bh; ++by)
+            {
+                for (uint32_t bx = 0; bx < bw; ++bx)
+                {
+                    // levels smaller than a block repeat their edge pixels
+                    for (uint32_t i = 0; i < 16; ++i)
+                    {
+                        auto x = std::min(bx * 4 + i % 4, width - 1);
+                        auto y = std::min(by * 4 + i / 4, height - 1);
+                        std::copy_n(rgba + (static_cast<std::size_t>(y) * width + x) * 4, 4, pixels + i * 4);
+                    }
+                    encodeBlock(pixels, blocks + (static_cast<std::size_t>(by) * bw + bx) * BLOCK_SIZE);
+                }
+            }
+        }
+
+        void downsample(const uint8_t *src, uint32_t width, uint32_t height, uint8_t *dst)
+        {
+            auto dw = std::max(1u, width / 2);
+            auto dh = std::max(1u, height / 2);
+            for (uint32_t y = 0; y < dh; ++y)
+            {
+                auto y0 = std::min(y * 2, height - 1);
+                auto y1 = std::min(y * 2 + 1, height - 1);
+                for (uint32_t x = 0; x < dw; ++x)
+                {
+                    auto x0 = std::min(x * 2, width - 1);
+                    auto x1 = std::min(x * 2 + 1, width - 1);
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        auto sum = src[(static_cast<std::size_t>(y0) * width + x0) * 4 + c]
+                                 + src[(static_cast<std::size_t>(y0) * width + x1) * 4 + c]
+                                 + src[(static_cast<std::size_t>(y1) * width + x0) * 4 + c]
+                                 + src[(static_cast<std::size_t>(y1) * width + x1) * 4 + c];
+                        dst[(static_cast<std::size_t>(y) * dw + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+                    }
+                }
+            }
+        }
+    }
+
+    bool canEncode(uint32_t width, uint32_t height)
+    {
+        auto powerOfTwo = [](uint32_t v) { return v != 0 && (v & (v - 1)) == 0; };
+        return width >= 4 && height >= 4 && powerOfTwo(width) && powerOfTwo(height);
+    }
+
+    uint32_t mipLevels(uint32_t width, uint32_t height)
+    {
+        uint32_t levels = 1;
+        for (auto size = std::max(width, height); size > 1; size /= 2)
+            levels++;
+        return levels;
+    }
+
+    std::size_t encodedSize(uint32_t width, uint32_t height, uint32_t levels)
+    {
+        return levelOffset(width, height, levels);
+    }
+
+    bool isOpaque(const uint8_t *rgba, std::size_t pixels)
+    {
+        for (std::size_t i = 0; i < pixels; ++i)
+            if(rgba[i * 4 + 3] != 255)
+                return false;
+        return true;
+    }
+
+    void encode(const uint8_t *rgba, uint32_t width, uint32_t height, uint32_t levels, uint8_t *blocks)
+    {
+        std::vector<uint8_t> current, next;
+        auto level = rgba;
+        for (uint32_t l = 0; l < levels; ++l)
+        {
+            auto lw = std::max(1u, width >> l);
+            auto lh = std::max(1u, height >> l);
+            encodeLevel(level, lw, lh, blocks + levelOffset(width, height, l));
+
+            if(l + 1 < levels)
+            {
+                next.resize(static_cast<std::size_t>(std::max(1u, lw / 2)) * std::max(1u, lh / 2) * 4);
+                downsample(level, lw, lh, next.data());
+                current.swap(next);
+                level = current.data();
+            }
+        }
+    }
+
+    void encodeRegion(const uint8_t *rgba, uint32_t width, uint32_t height, uint32_t levels,
+                      uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, uint8_t *blocks)
+    {
+        x1 = std::min(x1, width);
+        y1 = std::min(y1, height);
+        if(x0 >= x1 || y0 >= y1)
+            return;
+
+        uint8_t pixels[16 * 4];
+        std::vector<uint8_t> footprint, next;
+        for (uint32_t l = 0; l < levels; ++l)
+        {
+            auto lw = std::max(1u, width >> l);
+            auto lh = std::max(1u, height >> l);
+            auto bw = blocksAcross(width, l);
+            auto bh = blocksAcross(height, l);
+            auto out = blocks + levelOffset(width, height, l);
+
+            auto bx1 = std::min(bw, (((x1 - 1) >> l) / 4) + 1);
+            auto by1 = std::min(bh, (((y1 - 1) >> l) / 4) + 1);
+            for (auto by = (y0 >> l) / 4; by < by1; ++by)
+            {
+                for (auto bx = (x0 >> l) / 4; bx < bx1; ++bx)
+                {
+                    // the footprint of the block on level 0 is filtered down the same way encode does it,
+                    // on power of two sides it halves exactly like the whole image so the blocks match
+                    auto sx0 = (bx * 4) << l, sx1 = std::min((bx * 4 + 4) << l, width);
+                    auto sy0 = (by * 4) << l, sy1 = std::min((by * 4 + 4) << l, height);
+                    auto fw = sx1 - sx0, fh = sy1 - sy0;
+                    footprint.resize(static_cast<std::size_t>(fw) * fh * 4);
+                    for (auto sy = sy0; sy < sy1; ++sy)
+                        std::copy_n(rgba + (static_cast<std::size_t>(sy) * width + sx0) * 4, static_cast<std::size_t>(fw) * 4,
+                                    footprint.data() + static_cast<std::size_t>(sy - sy0) * fw * 4);
+                    for (uint32_t step = 0; step < l; ++step)
+                    {
+                        next.resize(static_cast<std::size_t>(std::max(1u, fw / 2)) * std::max(1u, fh / 2) * 4);
+                        downsample(footprint.data(), fw, fh, next.data());
+                        footprint.swap(next);
+                        fw = std::max(1u, fw / 2);
+                        fh = std::max(1u, fh / 2);
+                    }
+
+                    for (uint32_t i = 0; i < 16; ++i)
+                    {
+                        auto px = std::min(bx * 4 + i % 4, lw - 1) - bx * 4;
+                        auto py = std::min(by * 4 + i / 4, lh - 1) - by * 4;
+                        std::copy_n(footprint.data() + (static_cast<std::size_t>(py) * fw + px) * 4, 4, pixels + i * 4);
+                    }
+                    encodeBlock(pixels, out + (static_cast<std::size_t>(by) * bw + bx) * BLOCK_SIZE);
+                }
+            }
+        }
+    }
+
+    void decode(const uint8_t *blocks, uint32_t width, uint32_t height, uint8_t *rgba)
+    {
+        uint8_t pixels[16 * 4];
+        auto bw = blocksAcross(width, 0);
+        auto bh = blocksAcross(height, 0);
+        for (uint32_t by = 0; by < bh; ++by)
+        {
+            for (uint32_t bx = 0; bx < bw; ++bx)
+            {
+                decodeBlock(blocks + (static_cast<std::size_t>(by) * bw + bx) * BLOCK_SIZE, pixels);
+                for (uint32_t i = 0; i < 16; ++i)
+                {
+                    auto x = bx * 4 + i % 4;
+                    auto y = by * 4 + i / 4;
+                    if(x < width && y < height)
+                        std::copy_n(pixels + i * 4, 4, rgba + (static_cast<std::size_t>(y) * width + x) * 4);
+                }
+            }
+        }
+    }
+
+    void encodeBlock(const uint8_t *pixels, uint8_t *block)
+    {
+        // bounding box of the block with its diagonal picked by the sign of the covariance
+        Color lo{255, 255, 255}, hi{0, 0, 0}, mean;
+        for (int i = 0; i < 16; ++i)
+        {
+            auto p = pixels + i * 4;
+            lo = {std::min(lo.r, int(p[0])), std::min(lo.g, int(p[1])), std::min(lo.b, int(p[2]))};
+            hi = {std::max(hi.r, int(p[0])), std::max(hi.g, int(p[1])), std::max(hi.b, int(p[2]))};
+            mean.r += p[0];
+            mean.g += p[1];
+            mean.b += p[2];
+        }
+        mean = {mean.r / 16, mean.g / 16, mean.b / 16};
+
+        int covRG = 0, covRB = 0;
+        for (int i = 0; i < 16; ++i)
+        {
+            auto p = pixels + i * 4;
+            covRG += (p[0] - mean.r) * (p[1] - mean.g);
+            covRB += (p[0] - mean.r) * (p[2] - mean.b);
+        }
+        if(covRG < 0)
+            std::swap(lo.g, hi.g);
+        if(covRB < 0)
+            std::swap(lo.b, hi.b);
+
+        // pull the ends in a little, the extremes are rarely worth a palette entry
+        auto inset = [](int &a, int &b)
+        {
+            auto d = (b - a) / 16;
+            a += d;
+            b -= d;
+        };
+        inset(lo.r, hi.r);
+        inset(lo.g, hi.g);
+        inset(lo.b, hi.b);
+
+        auto c0 = pack565(hi);
+        auto c1 = pack565(lo);
+        if(c0 < c1)
+            std::swap(c0, c1);
+
+        uint32_t indices = 0;
+        if(c0 != c1)
+        {
+            Color palette[4];
+            palette[0] = unpack565(c0);
+            palette[1] = unpack565(c1);
+            palette[2] = mix(palette[0], palette[1], 2, 1);
+            palette[3] = mix(palette[0], palette[1], 1, 2);
+
+            for (int i = 0; i < 16; ++i)
+            {
+                uint32_t best = 0;
+                auto bestDistance = distance(palette[0], pixels + i * 4);
+                for (uint32_t j = 1; j < 4; ++j)
+                {
+                    auto d = distance(palette[j], pixels + i * 4);
+                    if(d < bestDistance)
+                    {
+                        bestDistance = d;
+                        best = j;
+                    }
+                }
+                indices |= best << (i * 2);
+            }
+        }
+
+        block[0] = static_cast<uint8_t>(c0 & 0xff);
+        block[1] = static_cast<uint8_t>(c0 >> 8);
+        block[2] = static_cast<uint8_t>(c1 & 0xff);
+        block[3] = static_cast<uint8_t>(c1 >> 8);
+        for (int i = 0; i < 4; ++i)
+            block[4 + i] = static_cast<uint8_t>(indices >> (i * 8));
+    }
+
+    void decodeBlock(const uint8_t *block, uint8_t *pixels)
+    {
+        auto c0 = static_cast<uint16_t>(block[0] | (block[1] << 8));
+        auto c1 = static_cast<uint16_t>(block[2] | (block[3] << 8));
+        uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | (static_cast<uint32_t>(block[7]) << 24);
+
+        Color palette[4];
+        palette[0] = unpack565(c0);
+        palette[1] = unpack565(c1);
+        if(c0 > c1)
+        {
+            palette[2] = mix(palette[0], palette[1], 2, 1);
+            palette[3] = mix(palette[0], palette[1], 1, 2);
+        }
+        else
+        {
+            palette[2] = mix(palette[0], palette[1], 1, 1);
+            palette[3] = Color{};
+        }
+
+        for (int i = 0; i < 16; ++i)
+        {
+            const auto &c = palette[(indices >> (i * 2)) & 3];
+            pixels[i * 4 + 0] = static_cast<uint8_t>(c.r);
+            pixels[i * 4 + 1] = static_cast<uint8_t>(c.g);
+            pixels[i * 4 + 2] = static_cast<uint8_t>(c.b);
+            pixels[i * 4 + 3] = 255;
+        }
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef BC1_H
+#define BC1_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace texcompress {
+
+    constexpr std::size_t BLOCK_SIZE = 8;
+
+    // power of two sides of at least 4 pixels keep every mip level a whole number of blocks
+    bool canEncode(uint32_t width, uint32_t height);
+
+    // full chain down to 1x1 pixels
+    uint32_t mipLevels(uint32_t width, uint32_t height);
+
+    // bytes of the given number of levels, level 0 first
+    std::size_t encodedSize(uint32_t width, uint32_t height, uint32_t levels);
+
+    bool isOpaque(const uint8_t *rgba, std::size_t pixels);
+
+    // rgba is width * height RGBA8 pixels, the lower levels are box filtered from it
+    void encode(const uint8_t *rgba, uint32_t width, uint32_t height, uint32_t levels, uint8_t *blocks);
+
+    // re-encodes the blocks covering pixels [x0, x1) x [y0, y1) of level 0 on every level
+    void encodeRegion(const uint8_t *rgba, uint32_t width, uint32_t height, uint32_t levels,
+                      uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, uint8_t *blocks);
+
+    // level 0 only, alpha comes out 255
+    void decode(const uint8_t *blocks, uint32_t width, uint32_t height, uint8_t *rgba);
+
+    void encodeBlock(const uint8_t *pixels, uint8_t *block);
+    void decodeBlock(const uint8_t *block, uint8_t *pixels);
+}
+
+#endif // BC1_H
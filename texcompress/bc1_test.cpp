@@ -0,0 +1,116 @@
+#include "bc1.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+// checks the encoder against itself, no reference images are needed
+
+namespace {
+    int failures = 0;
+
+    void check(bool ok, const char *what)
+    {
+        if(ok)
+            return;
+        std::cerr << "FAILED: " << what << std::endl;
+        failures++;
+    }
+
+    std::vector<uint8_t> gradient(uint32_t width, uint32_t height)
+    {
+        std::vector<uint8_t> rgba(static_cast<std::size_t>(width) * height * 4);
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                auto p = rgba.data() + (static_cast<std::size_t>(y) * width + x) * 4;
+                p[0] = static_cast<uint8_t>(x * 255 / (width - 1));
+                p[1] = static_cast<uint8_t>(y * 255 / (height - 1));
+                p[2] = static_cast<uint8_t>((x + y) * 255 / (width + height - 2));
+                p[3] = 255;
+            }
+        }
+        return rgba;
+    }
+
+    std::vector<uint8_t> noise(uint32_t width, uint32_t height, uint32_t seed)
+    {
+        std::vector<uint8_t> rgba(static_cast<std::size_t>(width) * height * 4);
+        for (std::size_t i = 0; i < rgba.size(); ++i)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            rgba[i] = i % 4 == 3 ? 255 : static_cast<uint8_t>(seed >> 24);
+        }
+        return rgba;
+    }
+
+    void roundTrip()
+    {
+        const uint32_t width = 64, height = 32;
+        auto rgba = gradient(width, height);
+
+        std::vector<uint8_t> blocks(texcompress::encodedSize(width, height, 1));
+        texcompress::encode(rgba.data(), width, height, 1, blocks.data());
+        std::vector<uint8_t> decoded(rgba.size());
+        texcompress::decode(blocks.data(), width, height, decoded.data());
+
+        int worst = 0;
+        for (std::size_t i = 0; i < rgba.size(); ++i)
+            worst = std::max(worst, std::abs(int(rgba[i]) - int(decoded[i])));
+        check(worst <= 16, "gradient survives a bc1 round trip within 16 levels");
+
+        // a flat block only loses what 565 can't hold
+        uint8_t flat[16 * 4], block[texcompress::BLOCK_SIZE], out[16 * 4];
+        for (int i = 0; i < 16; ++i)
+        {
+            flat[i * 4 + 0] = 200;
+            flat[i * 4 + 1] = 100;
+            flat[i * 4 + 2] = 50;
+            flat[i * 4 + 3] = 255;
+        }
+        texcompress::encodeBlock(flat, block);
+        texcompress::decodeBlock(block, out);
+        worst = 0;
+        for (int i = 0; i < 16 * 4; ++i)
+            worst = std::max(worst, std::abs(int(flat[i]) - int(out[i])));
+        check(worst <= 4, "flat block decodes to its colour");
+    }
+
+    void regionMatchesEncode(uint32_t width, uint32_t height, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1)
+    {
+        auto levels = texcompress::mipLevels(width, height);
+        auto rgba = noise(width, height, width * 31 + height);
+
+        std::vector<uint8_t> blocks(texcompress::encodedSize(width, height, levels));
+        texcompress::encode(rgba.data(), width, height, levels, blocks.data());
+
+        // paint the rectangle, then patch the old blocks and encode the painted image from scratch
+        auto paint = noise(width, height, x0 * 7 + y0 * 13 + 1);
+        for (auto y = y0; y < std::min(y1, height); ++y)
+            for (auto x = x0; x < std::min(x1, width); ++x)
+                for (int c = 0; c < 4; ++c)
+                    rgba[(static_cast<std::size_t>(y) * width + x) * 4 + c] = paint[(static_cast<std::size_t>(y) * width + x) * 4 + c];
+
+        texcompress::encodeRegion(rgba.data(), width, height, levels, x0, y0, x1, y1, blocks.data());
+        std::vector<uint8_t> expected(blocks.size());
+        texcompress::encode(rgba.data(), width, height, levels, expected.data());
+
+        check(blocks == expected, "encodeRegion gives the blocks of a full encode");
+    }
+}
+
+int main()
+{
+    roundTrip();
+
+    regionMatchesEncode(64, 64, 10, 12, 30, 40);
+    regionMatchesEncode(64, 16, 0, 0, 5, 5);
+    regionMatchesEncode(16, 64, 13, 60, 16, 64);
+    regionMatchesEncode(32, 32, 0, 0, 32, 32);
+    regionMatchesEncode(128, 8, 100, 3, 200, 9);
+
+    if(failures == 0)
+        std::cout << "bc1: all checks passed" << std::endl;
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}